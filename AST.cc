@@ -1,25 +1,24 @@
-#include <hc_list.h>
-#include <hc_list_helpers.h>
 #include "parser.h"  // for n_errors count; this should really be refactored
 #include "streams.h"
 
 using std::string;
 using std::endl;
-using HaverfordCS::list;
 
 
 #include <fstream>  /* needed for ofstream below */
+#include <iomanip>  /* for setw in traceNodeSizes */
 #if defined TRACE_EXPR_ALLOCATIONS
-static std::ofstream  alloc_trace(TRACE_EXPR_ALLOCATIONS);
+thread_local std::ofstream _HaverRacket_alloc_trace(TRACE_EXPR_ALLOCATIONS);
 #else
 // by default, allow option for control via environment variable, but it's not given, send to /dev/null (disappears)
-static std::ofstream alloc_trace(getenv("HAVERRACKET_ALLOC_TRACE")?getenv("HAVERRACKET_ALLOC_TRACE"):"/dev/null");
-// static std::ofstream &alloc_trace = trace;  // alternate easy option, just send to regular trace
+thread_local std::ofstream _HaverRacket_alloc_trace(getenv("HAVERRACKET_ALLOC_TRACE")?getenv("HAVERRACKET_ALLOC_TRACE"):"/dev/null");
 #endif
+thread_local std::ostream &alloc_trace = _HaverRacket_alloc_trace;
+// thread_local std::ostream &alloc_trace = trace;  // alternate easy option, just send to regular trace
 
 
 
-// This file has the constructors and destructors;
+// This file has the constructors;
 //   all the generateHERA methods are together in generateHERA.cc
 
 
@@ -32,26 +31,20 @@ static std::ofstream alloc_trace(getenv("HAVERRACKET_ALLOC_TRACE")?getenv("HAVER
 // whereas writing v(value) before the body is like writing
 //     int i=12;  // i is created with "12" from the start
 //
-// Those steps, as the call(s) to any superclass(es)' constructors, are done before the body of the IntLiteralNode itself
-IntLiteralNode::IntLiteralNode(int value) : v(value)
-{
-	// nothing else needs to be done here, since the stuff above defines "v" as "value"
-	alloc_trace << "(class IntLiteralNode constructor called for node at memory " << this << " and value=" << value << endl;
-}
+// Those steps, as the call(s) to any superclass(es)' constructors, are done before the body of e.g. the ComparisonNode itself
 
-BoolLiteralNode::BoolLiteralNode(string value) : v((value == "#t")? 1 : 0)
-{
-    // nothing else needs to be done here, since the stuff above defines "v" as "value"
-    alloc_trace << "(class BoolLiteralNode constructor called for node at memory " << this << " and value=" << value << endl;
-}
+// how many nodes of each kind this thread has made, for traceNodeSizes
+static thread_local unsigned long nodesMade[NUMBER_OF_NODE_KINDS];
 
-// (so, we should see this trace before the one above, for each int literal node)
-ExprNode::ExprNode()
+// (so, we should see this trace before the one from the subclass constructor, for each node)
+ExprNode::ExprNode(NodeKind kind, std::uint32_t hash) : structuralHash(hash), nodeKind(kind)
 {
+	nodesMade[kind]++;
 	alloc_trace << "[superclass ExprNode constructor  called for node at memory " << this << endl;
 }
 
-ComparisonNode::ComparisonNode(string op, ExprNode *lhs, ExprNode *rhs) :
+ComparisonNode::ComparisonNode(Operator op, ExprHandle lhs, ExprHandle rhs) :
+	ExprNode(COMPARISON_NODE, hashOf(op, lhs, rhs)),
 	o(op),
 	left(lhs),
 	right(rhs)
@@ -59,7 +52,8 @@ ComparisonNode::ComparisonNode(string op, ExprNode *lhs, ExprNode *rhs) :
 	alloc_trace << "(class ComparisonNode constructor called for node at memory " << this << endl;
 }
 
-ArithmeticNode::ArithmeticNode(string op, list<ExprNode *>operands) :
+ArithmeticNode::ArithmeticNode(Operator op, const ChildList &operands) :
+	ExprNode(ARITHMETIC_NODE, hashOf(op, operands)),
 	o(op),
 	subexps(operands)
 {
@@ -67,19 +61,16 @@ ArithmeticNode::ArithmeticNode(string op, list<ExprNode *>operands) :
 }
 
 
-VarUseNode::VarUseNode(string name) : n(name)
-{
-	alloc_trace << "(class     VarUseNode constructor called for node at memory " << this << endl;
-}
-
-CallNode::CallNode(string funcName, HaverfordCS::list<ExprNode *>arguments) :
+CallNode::CallNode(string funcName, const ChildList &arguments) :
+	ExprNode(CALL_NODE, hashOf(funcName, arguments)),
 	n(funcName),
 	argList(arguments)
 {
 	alloc_trace << "(class       CallNode constructor called for node at memory " << this << endl;
 }
 
-IfNode::IfNode(ExprNode *condition, ExprNode *expriftrue, ExprNode *expriffalse) :
+IfNode::IfNode(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse) :
+    ExprNode(IF_NODE, hashOf(condition, expriftrue, expriffalse)),
     condition(condition),
     expriftrue(expriftrue),
     expriffalse(expriffalse)
@@ -87,156 +78,103 @@ IfNode::IfNode(ExprNode *condition, ExprNode *expriftrue, ExprNode *expriffalse)
     alloc_trace << "(class IfNode constructor called for node at memory " << this << endl;
 }
 
-LetNode::LetNode(ExprNode *declarations, HaverfordCS::list<ExprNode *> expressions) :
+LetNode::LetNode(ExprHandle declarations, const ChildList &expressions) :
+        ExprNode(LET_NODE, hashOf(declarations, expressions)),
         declarations(declarations),
         expressions(expressions)
 {
     alloc_trace << "(class LetNode constructor called for node at memory " << this << endl;
 }
 
-DeclarationsNode::DeclarationsNode(HaverfordCS::list<ExprNode *> declarations) :
+DeclarationsNode::DeclarationsNode(const ChildList &declarations) :
+        ExprNode(DECLARATIONS_NODE, hashOf(declarations)),
         declarations(declarations)
 {
     alloc_trace << "(class DeclarationsNode constructor called for node at memory " << this << endl;
 }
 
-DeclarationNode::DeclarationNode(VarUseNode variable, IntLiteralNode intLiteral, string declType) :
-        variable(variable),
-        intLiteral(intLiteral),
-        declType(declType)
-{
-    alloc_trace << "(class DeclarationNode constructor called for node at memory " << this << endl;
-}
-
-DeclarationNode::DeclarationNode(VarUseNode variable, BoolLiteralNode boolLiteral, string declType) :
-        variable(variable),
-        boolLiteral(boolLiteral),
-        declType(declType)
-{
-    alloc_trace << "(class DeclarationNode constructor called for node at memory " << this << endl;
-}
-
-DeclarationNode::DeclarationNode(VarUseNode variable, VarUseNode definedVar, string declType) :
-        variable(variable),
-        definedVar(definedVar),
-        declType(declType)
-{
-    alloc_trace << "(class DeclarationNode constructor called for node at memory " << this << endl;
-}
-
-DeclarationNode::DeclarationNode(VarUseNode variable, ExprNode *expr, string declType) :
+DeclarationNode::DeclarationNode(SymbolID variable, ExprHandle value) :
+        ExprNode(DECLARATION_NODE, hashOf(variable, value)),
         variable(variable),
-        expr(expr),
-        declType(declType)
+        value(value)
 {
     alloc_trace << "(class DeclarationNode constructor called for node at memory " << this << endl;
 }
 
-// C++ Usage notes:
-//   When an object is destroyed, either because it is on the stack, e.g. as a variable,
-//     or because it is on the free-store heap, the _destructor(s)_ for the object,
-//     including those for the superclass(es) and data fields, are called before
-//     the memory for the object is released for potential re-use
-//     (destructors are called for those fields as they are released,
-//     and the superclass destructor is used after the class' own destructor is done).
-//
-//   Note that _pointers_ do not have destructor methods, so while e.g. when a "+" node
-//     goes away, the "string o" data field in the ArithmeticNode will automatically run,
-//     but nothing happens (by default) for the trees _pointed_to_ by "subexps".
-//     (ArithmeticNode's destructor also runs, of course, and so _it_ may take care of subexps)
-
-ExprNode::~ExprNode()  // nothing to do, but this ensures all subclasses will have virtual destructors, which C++ likes
+// The structural hashes, for each constructor above, and for NodeFactory
+std::uint32_t ComparisonNode::hashOf(Operator op, ExprHandle lhs, ExprHandle rhs)
 {
-	alloc_trace << " superclass ExprNode destructor   called for node at memory " << this << "]" << endl;
+	return StructuralHash(COMPARISON_NODE).add(op).add(lhs).add(rhs).value();
 }
 
-IntLiteralNode::~IntLiteralNode()
+std::uint32_t ArithmeticNode::hashOf(Operator op, const ChildList &operands)
 {
-	alloc_trace << " class IntLiteralNode  destructor called for node at memory " << this << " that had value=" << v << ")" << endl;
-	// nothing needs to be done here,
-	//  except for tracing we could have omitted this.
+	return StructuralHash(ARITHMETIC_NODE).add(op).add(operands).value();
 }
 
-BoolLiteralNode::~BoolLiteralNode()
+std::uint32_t CallNode::hashOf(const string &funcName, const ChildList &arguments)
 {
-    alloc_trace << " class BoolLiteralNode  destructor called for node at memory " << this << " that had value=" << v << ")" << endl;
-    // nothing needs to be done here,
-    //  except for tracing we could have omitted this.
+	return StructuralHash(CALL_NODE).add(funcName).add(arguments).value();
 }
 
-#if FREE_AST_VIA_DESTRUCTORS
-
-// Memory management strategy:
-//   In a _Tree_, we know that any node will have at most one parent.
-//   Since the parser returns a pointer to the _root_,
-//     and no methods give access to any node's child pointers,
-//     we know that, when the root goes away, all the sub-trees can go away too.
-//   So, when the main program "delete"s the root,
-//     that will trigger the root's destructor; if that delete's any tree children,
-//     the whole thing will then be destroyed recursively.
-
-// Note that no destructor is needed for "IntLiteralNode".
-//   It has no subtrees, and data fields go away automatically when the node is deleted
-
-// In contrast, a ComparisonNode has subtree pointers "left" and "right".
-//   When we delete a ComparisonNode, those _pointers_ go away,
-//   but the trees on the free-store heap will last until we delete them.
-//   Since, as noted, we know there are no other pointers to them,
-//   we delete them when the ComparisonNode goes away:
-
-ComparisonNode::~ComparisonNode()
+std::uint32_t IfNode::hashOf(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse)
 {
-	alloc_trace << " class ComparisonNode  destructor called for node at memory " << this << ")" << endl;
-
-	delete left;
-	delete right;
+	return StructuralHash(IF_NODE).add(condition).add(expriftrue).add(expriffalse).value();
 }
 
-void deleteAllSubtrees(list<ExprNode *>subtrees)
+std::uint32_t LetNode::hashOf(ExprHandle declarations, const ChildList &expressions)
 {
-	if (!empty(subtrees)) {
-		delete head(subtrees);
-		deleteAllSubtrees(rest(subtrees));
-	}
+	return StructuralHash(LET_NODE).add(declarations).add(expressions).value();
 }
 
-ArithmeticNode::~ArithmeticNode()
+std::uint32_t DeclarationsNode::hashOf(const ChildList &declarations)
 {
-	alloc_trace << " class ArithmeticNode  destructor called for node at memory " << this << ")" << endl;
-	
-	deleteAllSubtrees(subexps);
+	return StructuralHash(DECLARATIONS_NODE).add(declarations).value();
 }
 
-VarUseNode::~VarUseNode()
+std::uint32_t DeclarationNode::hashOf(SymbolID variable, ExprHandle value)
 {
-	alloc_trace << " class     VarUseNode  destructor called for node at memory " << this << ")" << endl;
+	return StructuralHash(DECLARATION_NODE).add(variable).add(value).value();
 }
 
-CallNode::~CallNode()
-{
-	alloc_trace << " class       CallNode  destructor called for node at memory " << this << ")" << endl;
-	
-	deleteAllSubtrees(argList);
-}
-
-IfNode::~IfNode()
-{
-    alloc_trace << " class     IfNode  destructor called for node at memory " << this << ")" << endl;
-}
-
-LetNode::~LetNode()
-{
-    alloc_trace << " class     LetNode  destructor called for node at memory " << this << ")" << endl;
-}
+// These tables are indexed by NodeKind (see AST.h), so keep them in the same order as that enum;
+//   the immediate kinds take no space of their own (they're inside an ExprHandle), so they never show up in traceNodeSizes
+static const char *const nodeKindNames[] = {
+	"IntLiteral", "BoolLiteral", "ComparisonNode", "ArithmeticNode", "VarUse",
+	"CallNode", "IfNode", "LetNode", "DeclarationsNode", "DeclarationNode"
+};
+static const std::size_t nodeSizes[] = {
+	0, 0, sizeof(ComparisonNode), sizeof(ArithmeticNode), 0,
+	sizeof(CallNode), sizeof(IfNode), sizeof(LetNode), sizeof(DeclarationsNode), sizeof(DeclarationNode)
+};
+static_assert(sizeof(nodeKindNames)/sizeof(nodeKindNames[0]) == NUMBER_OF_NODE_KINDS, "a name for each NodeKind");
+static_assert(sizeof(nodeSizes)/sizeof(nodeSizes[0]) == NUMBER_OF_NODE_KINDS, "a size for each NodeKind");
+static_assert(alignof(ExprNode) >= 8, "nodes must leave the low 3 bits of their addresses free for ExprHandle tags");
 
-DeclarationsNode::~DeclarationsNode()
+const char *nodeKindName(NodeKind kind)
 {
-    alloc_trace << " class     DeclarationsNode  destructor called for node at memory " << this << ")" << endl;
+	return nodeKindNames[kind];
 }
 
-DeclarationNode::~DeclarationNode()
+void traceNodeSizes()
 {
-    alloc_trace << " class     DeclarationsNode  destructor called for node at memory " << this << ")" << endl;
+	unsigned long totalNodes = 0, totalBytes = 0;
+	alloc_trace << "AST nodes made:       count  bytes each  total bytes" << endl;
+	for (int k = 0; k < NUMBER_OF_NODE_KINDS; k++) {
+		if (nodesMade[k] == 0) continue;
+		alloc_trace << "  " << std::left << std::setw(18) << nodeKindNames[k] << std::right
+		            << std::setw(8) << nodesMade[k] << std::setw(12) << nodeSizes[k]
+		            << std::setw(13) << nodesMade[k] * nodeSizes[k] << endl;
+		totalNodes += nodesMade[k];
+		totalBytes += nodesMade[k] * nodeSizes[k];
+		nodesMade[k] = 0;
+	}
+	alloc_trace << "  " << std::left << std::setw(18) << "total" << std::right
+	            << std::setw(8) << totalNodes << std::setw(25) << totalBytes << endl;
 }
 
-#endif
+// Memory management strategy:
+//   All the nodes of a program's tree are made in one Arena (see Arena.h), by the parser,
+//     and they all go away together when that Arena is released, once we're done with the tree.
+//   So there's no need for destructors that "delete" a node's subtrees,
+//     and nothing should ever "delete" an ExprNode.
@@ -1,30 +1,29 @@
 #ifndef AST_H_
 #define AST_H_
 
+#include <cstdint>
 #include <string>
-#include <hc_list.h>
 #include "ContextInfo.h"
 #include "Dictionary.h"
+#include "SymbolTable.h"
+#include "Diagnostics.h"
+#include "SmallVector.h"
 
 
 /*
  *  This file defines the heirarchy of different kinds of AST nodes.
  *  Currently we have:
  *    ExprNode (an "interface" class for expressions, with the following concrete subclasses ("implementers" of the interface):
- *	IntLiteralNode(int value)
- *	ComparisonNode(std::string op, ExprNode *lhs, ExprNode *rhs)
- *	ArithmeticNode(std::string op, list<ExprNode *>)
- *	VarUseNode(std::string name)
- *	CallNode(std::string name, HaverfordCS::list<ExprNode *>arguments)
+ *	ComparisonNode(Operator op, ExprHandle lhs, ExprHandle rhs)
+ *	ArithmeticNode(Operator op, ChildList)
+ *	CallNode(std::string name, ChildList arguments)
+ *	IfNode, LetNode, DeclarationsNode, DeclarationNode
+ *    Integer and boolean literals and variable uses aren't nodes; see ExprHandle below.
  *
  *  The "generateHERA" methods are usually called by calling generateFullHERA on the root,
  *      which puts "CBON" at the start.
  */
 
-#if ! defined FREE_AST_VIA_DESTRUCTORS
-#define FREE_AST_VIA_DESTRUCTORS true
-#endif
-
 // C++ Usage Note:
 // The empty class definition of ContextInfo below lets us declare "const ContextInfo &" parameters
 //   without having to define the whole class here, which is fine because, at this point,
@@ -34,8 +33,75 @@
 
 // Define the information will we need to pass down the tree as we generate code, see ContextInfo.h
 class ContextInfo;
+// ... and where the code goes, see HERACode.h
+class HERACode;
+
+class ExprNode;
+// The operators of ArithmeticNode and ComparisonNode;
+//   these are used as indices into tables, e.g. of operator names and HERA instructions
+enum Operator : unsigned char {
+	OP_PLUS, OP_MINUS, OP_TIMES,                 // arithmetic
+	OP_EQUAL, OP_LESS_EQUAL, OP_GREATER_EQUAL,   // comparison
+	OP_LESS, OP_GREATER, OP_NOT_EQUAL
+};
+const char *operatorName(Operator op);  // e.g. "<=" for OP_LESS_EQUAL
+
+// The kinds of expression, one for each ExprNode subclass below, plus the "immediate" ones
+//   that are kept in an ExprHandle rather than a node, so that e.g. codegen can check
+//   what kind of expression a child is with a one-byte comparison (rather than comparing strings)
+enum NodeKind : unsigned char {
+	INT_LITERAL_NODE, BOOL_LITERAL_NODE, COMPARISON_NODE, ARITHMETIC_NODE, VAR_USE_NODE,
+	CALL_NODE, IF_NODE, LET_NODE, DECLARATIONS_NODE, DECLARATION_NODE,
+	NUMBER_OF_NODE_KINDS  // not a kind of node; keep this last
+};
+const char *nodeKindName(NodeKind kind);  // e.g. "ComparisonNode" for COMPARISON_NODE
+
+// write to alloc_trace how many nodes of each kind this thread has made since the last call,
+//   and how much memory they take
+void traceNodeSizes();
+
+
+// An ExprHandle refers to an expression: usually an ExprNode (in an Arena), but
+//   integers, booleans, and variable uses, which are most of the leaves of a typical tree,
+//   are "immediates": the value itself is packed into the handle, so they need no node at all.
+// Nodes are at least 8-byte aligned, so the low 3 bits of a node's address are always 0;
+//   an immediate has a nonzero "tag" there instead, and its value in the rest of the bits.
+class ExprHandle {
+public:
+	ExprHandle() : bits(0) { }  // refers to nothing, e.g. in place of an E with a syntax error
+	ExprHandle(ExprNode *node) : bits(reinterpret_cast<std::uintptr_t>(node)) { }
+
+	static ExprHandle integer(int value)     { return ExprHandle(INT_TAG, value); }
+	static ExprHandle boolean(bool value)    { return ExprHandle(BOOL_TAG, value ? 1 : 0); }
+	static ExprHandle variable(SymbolID name) { return ExprHandle(VAR_TAG, name); }
+
+	bool isNull() const { return bits == 0; }
+	bool operator==(ExprHandle other) const { return bits == other.bits; }  // the same node, or equal immediates
+	bool isImmediate() const { return (bits & TAG_MASK) != NODE_TAG; }
+	NodeKind kind() const;  // precondition: !isNull()
+
+	// add the code for this expression to the end of "code": a node's generateHERA method is called,
+	//   while immediates are handled right here, without any virtual call (see generateHERA.cc)
+	void generateHERA(const ContextInfo &info, HERACode &code) const;
+
+	// precondition for these: isImmediate() or !isImmediate(), respectively
+	int value() const { return static_cast<int>(static_cast<std::intptr_t>(bits) >> TAG_BITS); }  // the integer, 0/1, or SymbolID
+	ExprNode *node() const { return reinterpret_cast<ExprNode *>(bits); }
+private:
+	enum Tag { NODE_TAG = 0, INT_TAG = 1, BOOL_TAG = 2, VAR_TAG = 3 };
+	static const int TAG_BITS = 3;
+	static const std::uintptr_t TAG_MASK = (1 << TAG_BITS) - 1;
+
+	ExprHandle(Tag tag, int value) : bits((static_cast<std::uintptr_t>(static_cast<std::intptr_t>(value)) << TAG_BITS) | tag) { }
+
+	std::uintptr_t bits;
+};
+
+// The children of a node that can have any number of them, in order;
+//   most have just one or two, which fit inside the ChildList itself
+typedef SmallVector<ExprHandle, 2> ChildList;
 
-extern Dictionary declarationDict;
+extern thread_local Dictionary declarationDict;  // thread_local, since each thread compiles its own program
 
 // C++ Usage Note:
 //
@@ -47,8 +113,9 @@ extern Dictionary declarationDict;
 // Putting "= 0" at the end of a virtual function declaration means
 //   that the method _must_ be overridden in subclasses
 //
-// Classes with virtual functions and (in subclasses) data with destructors need to have
-//  virtual destructors, to help the C++ compiler be sure the right data destructors are called
+// Classes with virtual functions usually need virtual destructors, so that "delete"ing a subclass object
+//  via a superclass pointer runs the right destructors; but our nodes are never "delete"d (see Arena.h),
+//  so ExprNode's destructor is "protected" instead, which stops anyone from trying
 
 
 // Class ExprNode is an interface that defines the methods that all
@@ -58,188 +125,179 @@ extern Dictionary declarationDict;
 
 class ExprNode {
 public:
-	ExprNode();           // just used for memory allocation labs, to print trace information
-	virtual ~ExprNode();  // used for actual memory allocation, sometimes, and for tracing
 
-    virtual std::string generateHERA(const ContextInfo &info) const = 0;
-    virtual std::string getType() const = 0;
+	ExprNode(NodeKind kind, std::uint32_t hash);  // also counts the nodes made (see traceNodeSizes), and prints trace information
+
+    virtual void generateHERA(const ContextInfo &info, HERACode &code) const = 0;  // adds to the end of "code"
+    NodeKind kind() const { return nodeKind; }
+    std::uint32_t hash() const { return structuralHash; }  // see StructuralHash, below
 
-    ExprNode* operator==(ExprNode *other) {
-        this->type = other->type;
-        return this;
-    }
+protected:
+    ~ExprNode() = default;  // the Arena runs the subclass destructors, if there's anything for them to do
 private:
-    std::string type;
+    // (in this order, a subclass's own one-byte data, e.g. an Operator, can go in the space after nodeKind)
+    const std::uint32_t structuralHash;
+    const NodeKind nodeKind;
 };
 
-std::string generateFullHERA(ExprNode *presumedRoot);
-
-
-
-// Now, the various specific kinds of expressions we might have:
+// A StructuralHash is built up from a node's kind, its own data (e.g. its Operator), and its children,
+//   so that structurally equal trees have equal hashes (though unequal trees may, rarely, too).
+// Each node's hash is computed once, when it's made, from its children's (cached) hashes,
+//   so the hash of a whole tree never needs a walk through the tree; see NodeFactory.h for what it's for.
+class StructuralHash {
+public:
+	StructuralHash(NodeKind kind) : h(2166136261u) { add(kind); }
+
+	// C++ Usage Note: returning *this lets us write e.g. StructuralHash(IF_NODE).add(a).add(b).add(c)
+	StructuralHash &add(std::uint32_t data) { h = (h ^ data) * 16777619u; return *this; }  // (this is FNV-1a, a word at a time)
+	StructuralHash &add(ExprHandle child)
+	{
+		if (child.isNull()) return add(0u);
+		return child.isImmediate() ? add(child.kind()).add(child.value()) : add(child.node()->hash());
+	}
+	StructuralHash &add(const ChildList &children)
+	{
+		add(children.size());
+		for (ExprHandle child : children) add(child);
+		return *this;
+	}
+	StructuralHash &add(const std::string &text)
+	{
+		for (unsigned char c : text) add(c);
+		return *this;
+	}
+
+	std::uint32_t value() const  // with the bits mixed up a bit more (as in MurmurHash3), for hash tables
+	{
+		std::uint32_t x = h;
+		x ^= x >> 16;  x *= 0x85ebca6bu;
+		x ^= x >> 13;  x *= 0xc2b2ae35u;
+		x ^= x >> 16;
+		return x;
+	}
+private:
+	std::uint32_t h;
+};
 
-class IntLiteralNode : public ExprNode {
-	public:
-		IntLiteralNode(int value);
-		~IntLiteralNode();  // just used for trace output
+inline NodeKind ExprHandle::kind() const
+{
+	switch (bits & TAG_MASK) {
+		case INT_TAG:  return INT_LITERAL_NODE;
+		case BOOL_TAG: return BOOL_LITERAL_NODE;
+		case VAR_TAG:  return VAR_USE_NODE;
+		default:       return node()->kind();
+	}
+}
 
-        int getValue() const { return v; }
-        std::string getType() const { return type; }
+// type errors are reported to "problems"; if there are any, the code shouldn't be used;
+//   the types of the nodes come from "types", if it's given (see TypeInference.h)
+class TypeInference;
+std::string generateFullHERA(ExprHandle presumedRoot, Diagnostics &problems, TypeInference &types);
+std::string generateFullHERA(ExprHandle presumedRoot, Diagnostics &problems);
+// the same code, as instructions rather than text (generateFullHERA is "\n" and then this code's text)
+HERACode generateHERACode(ExprHandle presumedRoot, Diagnostics &problems, TypeInference &types);
 
-		std::string generateHERA(const ContextInfo &info) const;
-	private:
-		int v;  // the value
-        const std::string type = "IntLiteralNode";
-};
 
-class BoolLiteralNode : public ExprNode {
-public:
-    BoolLiteralNode(std::string value);
-    ~BoolLiteralNode();  // just used for trace output
 
-    int getValue() const { return v; }
-    std::string getType() const { return type; }
+// Now, the various specific kinds of expressions we might have:
+//   (once made, a node never changes, so one node can be shared by several trees; see NodeFactory.h)
 
-    std::string generateHERA(const ContextInfo &info) const;
-private:
-    int v;  // the value
-    const std::string type = "BoolLiteralNode";
-};
+// (Integers, booleans, and variable uses have no node class; they're immediates in an ExprHandle)
 
 class ComparisonNode : public ExprNode {  // <= etc., _inherently_binary_ in HaverRacket
 public:
-    ComparisonNode(std::string op, ExprNode *lhs, ExprNode *rhs);
-#if FREE_AST_VIA_DESTRUCTORS
-    ~ComparisonNode();
-#endif
-    std::string getType() const { return type; }
-
-    std::string generateHERA(const ContextInfo &info) const;
+    ComparisonNode(Operator op, ExprHandle lhs, ExprHandle rhs);
+    static std::uint32_t hashOf(Operator op, ExprHandle lhs, ExprHandle rhs);  // the hash() of a node made with these
+
+    void generateHERA(const ContextInfo &info, HERACode &code) const;
+    // the code for when this is an if's condition: rather than giving 0 or 1, go to the label if it's false
+    void generateBranchHERA(const ContextInfo &info, const ContextInfo &falseLabelContext, HERACode &code) const;
+    Operator getOperator() const { return o; }
+    ExprHandle getLeft() const { return left; }
+    ExprHandle getRight() const { return right; }
 private:
-    std::string o;
-    ExprNode *left;
-    ExprNode *right;
-    const std::string type = "ComparisonNode";
+    const Operator o;
+    const ExprHandle left;
+    const ExprHandle right;
 };
 
 class ArithmeticNode : public ExprNode {  // +, *, -, etc.
 	public:
-		ArithmeticNode(std::string op, HaverfordCS::list<ExprNode *>);
-#if FREE_AST_VIA_DESTRUCTORS
-		~ArithmeticNode();
-#endif
-        std::string getType() const { return type; }
-
-        std::string generateHERA(const ContextInfo &info) const;
-	private:
-		std::string o;
-		HaverfordCS::list<ExprNode *>subexps;
-        const std::string type = "ArithmeticNode";
-};
-
-/*
-   This represents the use of an identifier as an expression, e.g. the x in (* x 6).
-   Note that identifiers also exist in variable declarations, e.g. (let ((x 7)) ... )
-     but the x there doesn't count as an _expression_ since we're not asking for its value.
- */
-class VarUseNode : public ExprNode {
-	public:
-		VarUseNode(std::string name);
-		~VarUseNode();
+		ArithmeticNode(Operator op, const ChildList &operands);
+		static std::uint32_t hashOf(Operator op, const ChildList &operands);
 
-        std::string getValue() const { return n; }
-        std::string getType() const { return type; }
-
-        std::string generateHERA(const ContextInfo &info) const;
+        void generateHERA(const ContextInfo &info, HERACode &code) const;
+		Operator getOperator() const { return o; }
+		const ChildList &getOperands() const { return subexps; }
 	private:
-		std::string n;
-        const std::string type = "VarUseNode";
+		const Operator o;
+		const ChildList subexps;
 };
 
-
 class CallNode : public ExprNode {
 	public:
-		CallNode(std::string funcName, HaverfordCS::list<ExprNode *>arguments);
-#if FREE_AST_VIA_DESTRUCTORS
-		~CallNode();
-#endif
-        std::string getType() const { return type; }
+		CallNode(std::string funcName, const ChildList &arguments);
+		static std::uint32_t hashOf(const std::string &funcName, const ChildList &arguments);
 
-        std::string generateHERA(const ContextInfo &info) const;
+        void generateHERA(const ContextInfo &info, HERACode &code) const;
+		const std::string &getName() const { return n; }
+		const ChildList &getArguments() const { return argList; }
 	private:
-		std::string n;  // the name
-		HaverfordCS::list<ExprNode *>argList;
-        const std::string type = "CallNode";
+		const std::string n;  // the name
+		const ChildList argList;
 };
 
 class IfNode : public ExprNode {
 public:
-    IfNode(ExprNode *condition, ExprNode *expriftrue, ExprNode *expriffalse);
-#if FREE_AST_VIA_DESTRUCTORS
-    ~IfNode();
-#endif
-    std::string getType() const { return type; }
+    IfNode(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse);
+    static std::uint32_t hashOf(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse);
 
-    std::string generateHERA(const ContextInfo &info) const;
+    void generateHERA(const ContextInfo &info, HERACode &code) const;
+    ExprHandle getCondition() const { return condition; }
+    ExprHandle getIfTrue() const { return expriftrue; }
+    ExprHandle getIfFalse() const { return expriffalse; }
 private:
-    ExprNode *condition;
-    ExprNode *expriftrue;
-    ExprNode *expriffalse;
-    const std::string type = "IfNode";
+    const ExprHandle condition;
+    const ExprHandle expriftrue;
+    const ExprHandle expriffalse;
 };
 
 class DeclarationsNode : public ExprNode {
 public:
-    DeclarationsNode(HaverfordCS::list<ExprNode *> declarations);
-    HaverfordCS::list<ExprNode *> getDeclarations();
-    std::string declarationsHelper(std::string declarationsHERA, HaverfordCS::list<ExprNode *> declarations, ContextInfo context) const;
-#if FREE_AST_VIA_DESTRUCTORS
-    ~DeclarationsNode();
-#endif
-    std::string getType() const { return type; }
-
-    std::string generateHERA(const ContextInfo &info) const;
+    DeclarationsNode(const ChildList &declarations);
+    static std::uint32_t hashOf(const ChildList &declarations);
+
+    void generateHERA(const ContextInfo &info, HERACode &code) const;
+    const ChildList &getDeclarations() const { return declarations; }
 private:
-    HaverfordCS::list<ExprNode *> declarations;
-    const std::string type = "DeclarationsNode";
+    const ChildList declarations;
 };
 
+// a "[ variable value ]" in a let*, where the value is an integer, a boolean, another variable, or "( ... )"
 class DeclarationNode : public ExprNode {
 public:
-    DeclarationNode(VarUseNode variable, IntLiteralNode intLiteral, string declType);
-    DeclarationNode(VarUseNode variable, BoolLiteralNode boolLiteral, string declType);
-    DeclarationNode(VarUseNode variable, VarUseNode definedVar, string declType);
-    DeclarationNode(VarUseNode variable, ExprNode *expr, string declType);
-#if FREE_AST_VIA_DESTRUCTORS
-    ~DeclarationNode();
-#endif
-    std::string getType() const { return type; }
-
-    std::string generateHERA(const ContextInfo &info) const;
+    DeclarationNode(SymbolID variable, ExprHandle value);
+    static std::uint32_t hashOf(SymbolID variable, ExprHandle value);
+
+    void generateHERA(const ContextInfo &info, HERACode &code) const;
+    SymbolID getVariable() const { return variable; }
+    ExprHandle getValue() const { return value; }
 private:
-    VarUseNode variable;
-    VarUseNode definedVar = VarUseNode("defaultVar");
-    std::string declType;
-    IntLiteralNode intLiteral = IntLiteralNode(0);
-    BoolLiteralNode boolLiteral = BoolLiteralNode("#f");
-    ExprNode *expr = new IntLiteralNode(0);
-    const std::string type = "DeclarationNode";
+    const SymbolID variable;
+    const ExprHandle value;
 };
 
 class LetNode : public ExprNode {
 public:
-    LetNode(ExprNode *declarations, HaverfordCS::list<ExprNode *> expressions);
-#if FREE_AST_VIA_DESTRUCTORS
-    ~LetNode();
-#endif
-    std::string getType() const { return type; }
-
-    std::string generateHERA(const ContextInfo &info) const;
-    std::string expressionsHelper(std::string expressionsHERA, HaverfordCS::list<ExprNode *> expressions, ContextInfo context) const;
+    LetNode(ExprHandle declarations, const ChildList &expressions);
+    static std::uint32_t hashOf(ExprHandle declarations, const ChildList &expressions);
+
+    void generateHERA(const ContextInfo &info, HERACode &code) const;
+    ExprHandle getDeclarations() const { return declarations; }
+    const ChildList &getExpressions() const { return expressions; }
     private:
-    ExprNode *declarations;
-    HaverfordCS::list<ExprNode *> expressions;
-    const std::string type = "LetNode";
+    const ExprHandle declarations;
+    const ChildList expressions;
 };
 
 #endif /*AST_H_*/
@@ -0,0 +1,93 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include "Arena.h"
+#include "streams.h"
+
+using std::endl;
+
+// Chunks start at this size and double, up to the maximum; anything bigger gets a chunk of its own
+static const std::size_t FIRST_CHUNK_SIZE = 64 * 1024;
+static const std::size_t MAX_CHUNK_SIZE   = 4 * 1024 * 1024;
+
+Arena::Arena(std::size_t budget) : budget(budget)
+{
+}
+
+Arena::~Arena()
+{
+	release();
+	if (chunks) {
+		std::free(chunks);
+	}
+}
+
+void *Arena::allocateInNewChunk(std::size_t size, std::size_t alignment)
+{
+	std::size_t header = (sizeof(Chunk) + alignment - 1) & ~(alignment - 1);
+	std::size_t needed = header + size;
+
+	std::size_t chunkSize = chunks ? 2 * chunks->size : FIRST_CHUNK_SIZE;
+	if (chunkSize > MAX_CHUNK_SIZE) chunkSize = MAX_CHUNK_SIZE;
+	if (chunkSize < needed) chunkSize = needed;
+	if (budget != 0 && reserved + chunkSize > budget) {
+		// use whatever is left of the budget, if that's enough
+		if (reserved + needed > budget) {
+			throw "the program needs more memory than the AST budget allows";
+		}
+		chunkSize = budget - reserved;
+	}
+
+	Chunk *chunk = static_cast<Chunk *>(std::malloc(chunkSize));
+	if (!chunk) throw std::bad_alloc();
+	chunk->previous = chunks;
+	chunk->size = chunkSize;
+	chunks = chunk;
+	reserved += chunkSize;
+
+	char *start = reinterpret_cast<char *>(chunk) + header;
+	next = start + size;
+	limit = reinterpret_cast<char *>(chunk) + chunkSize;
+	used += size;
+	return start;
+}
+
+Arena::Cleanup *Arena::newCleanup()
+{
+	return static_cast<Cleanup *>(allocate(sizeof(Cleanup), alignof(Cleanup)));
+}
+
+void Arena::addCleanup(Cleanup *cleanup, void (*destroy)(void *), void *object)
+{
+	cleanup->destroy = destroy;
+	cleanup->object = object;
+	cleanup->previous = cleanups;
+	cleanups = cleanup;
+}
+
+void Arena::release()
+{
+	for (Cleanup *cleanup = cleanups; cleanup; cleanup = cleanup->previous) {
+		cleanup->destroy(cleanup->object);
+	}
+	cleanups = nullptr;
+
+	if (used > mostUsed) mostUsed = used;
+	if (used > 0) {
+		alloc_trace << "Arena released: " << used << " bytes used in " << reserved << " bytes of chunks; "
+		            << "high-water mark " << mostUsed << " bytes" << endl;
+	}
+
+	// free all but the first (oldest) chunk, and start over at the beginning of that one
+	while (chunks && chunks->previous) {
+		Chunk *older = chunks->previous;
+		reserved -= chunks->size;
+		std::free(chunks);
+		chunks = older;
+	}
+	used = 0;
+	if (chunks) {
+		next = reinterpret_cast<char *>(chunks) + sizeof(Chunk);
+		limit = reinterpret_cast<char *>(chunks) + chunks->size;
+	}
+}
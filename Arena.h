@@ -0,0 +1,92 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+ *  An Arena hands out memory for the nodes of one program's AST (or anything else
+ *    that all goes away at the same time), by "bumping" a pointer through big chunks,
+ *    rather than calling "new" for each node and "delete" for each one afterwards.
+ *  "release" gives back everything made in the Arena at once, without walking the tree.
+ *
+ *  An Arena can have a "budget", the most bytes it may take from the system,
+ *    so a huge (or hostile) program can't use up all the memory of a long-running compiler;
+ *    "allocate" throws a "const char *" message if the budget would be exceeded.
+ *
+ *  The number of bytes used, and the most ever used at once (the "high-water mark"),
+ *    are written to alloc_trace (see streams.h) each time the Arena is released.
+ */
+
+class Arena {
+public:
+	Arena(std::size_t budget = 0);  // budget 0 means no limit
+	~Arena();
+
+	// memory for "size" bytes, aligned to "alignment" (which must be a power of 2)
+	void *allocate(std::size_t size, std::size_t alignment)
+	{
+		char *start = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(next) + alignment - 1) & ~(alignment - 1));
+		if (!next || start + size > limit) {
+			return allocateInNewChunk(size, alignment);
+		}
+		used += start + size - next;
+		next = start + size;
+		return start;
+	}
+
+	// make a new T in the Arena, e.g. arena.make<IfNode>(c, t, f) rather than new IfNode(c, t, f)
+	//  (if T has a destructor that does anything, it's run when the Arena is released)
+	template <typename T, typename... Args>
+	T *make(Args &&... args)
+	{
+		void *memory = allocate(sizeof(T), alignof(T));
+		// the cleanup record is allocated first, since that can throw (see "budget" above),
+		//   and once the T is built nothing may stop its destructor from being recorded
+		Cleanup *cleanup = std::is_trivially_destructible<T>::value ? nullptr : newCleanup();
+		T *it = new (memory) T(std::forward<Args>(args)...);  // C++ Usage Note: "placement new" builds a T at "memory"
+		if (cleanup) {
+			addCleanup(cleanup, [](void *object) { static_cast<T *>(object)->~T(); }, it);
+		}
+		return it;
+	}
+
+	// give back everything made in the Arena (keeping the first chunk, to use again)
+	void release();
+
+	std::size_t bytesUsed() const { return used; }
+	std::size_t bytesReserved() const { return reserved; }  // taken from the system, i.e. what counts against the budget
+	std::size_t highWaterMark() const { return mostUsed > used ? mostUsed : used; }
+
+	// C++ Usage Note: "= delete" prevents copying, since two copies would both free the same chunks
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+private:
+	struct Chunk {
+		Chunk *previous;
+		std::size_t size;  // including this header
+	};
+	struct Cleanup {
+		void (*destroy)(void *object);
+		void *object;
+		Cleanup *previous;
+	};
+
+	void *allocateInNewChunk(std::size_t size, std::size_t alignment);
+	Cleanup *newCleanup();  // memory for a Cleanup, not yet in "cleanups"
+	void addCleanup(Cleanup *cleanup, void (*destroy)(void *), void *object);  // doesn't throw
+
+	Chunk *chunks = nullptr;      // the newest, which links to older ones
+	char *next = nullptr;         // the next free byte in the newest chunk
+	char *limit = nullptr;        // the end of the newest chunk
+	Cleanup *cleanups = nullptr;  // the newest, which links to older ones
+	std::size_t budget;
+	std::size_t used = 0;
+	std::size_t reserved = 0;
+	std::size_t mostUsed = 0;
+};
+
+#endif /*ARENA_H_*/
@@ -0,0 +1,40 @@
+#ifndef CODE_BUFFER_H_
+#define CODE_BUFFER_H_
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/*
+ *  A CodeBuffer holds the code generated for a program, as one string that grows as code is added to its end.
+ *  Each node adds its own instructions right to the end, in the order they're to run,
+ *    so each instruction is written just once, rather than being returned as a string
+ *    and copied again into its parent's string, and its grandparent's, and so on up the tree;
+ *    generating a lot of code then takes time and memory in proportion to how much there is.
+ */
+
+// C++ Usage Note: returning *this from operator<< lets us write e.g. code << "SET(" << reg << ", " << 42 << ")\n",
+//   just as for an ostream, but without any of an ostream's formatting machinery
+
+class CodeBuffer {
+public:
+	CodeBuffer &operator<<(std::string_view text) { code.append(text); return *this; }
+	CodeBuffer &operator<<(char c) { code.push_back(c); return *this; }
+	CodeBuffer &operator<<(int n)
+	{
+		char digits[16];
+		char *end = std::to_chars(digits, digits + sizeof digits, n).ptr;
+		code.append(digits, end);
+		return *this;
+	}
+
+	std::size_t size() const { return code.size(); }
+	const std::string &text() const { return code; }
+	std::string take() { return std::move(code); }  // the code, leaving this CodeBuffer empty
+private:
+	std::string code;
+};
+
+#endif /*CODE_BUFFER_H_*/
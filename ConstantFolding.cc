@@ -0,0 +1,203 @@
+#include <vector>
+#include "ConstantFolding.h"
+
+// n as a HERA register would hold it, i.e. its low 16 bits, as a signed number
+static int wrap16(long n)
+{
+	n &= 0xffff;
+	return n >= 0x8000 ? n - 0x10000 : n;
+}
+
+int foldArithmetic(Operator op, int left, int right)
+{
+	long l = wrap16(left), r = wrap16(right);
+	switch (op) {
+		case OP_PLUS:  return wrap16(l + r);
+		case OP_MINUS: return wrap16(l - r);
+		case OP_TIMES: return wrap16(l * r);  // (MUL keeps the low 16 bits of the product)
+		default:       throw "foldArithmetic given an operator that isn't arithmetic";
+	}
+}
+
+// the code for a comparison does CMP, then e.g. BL, which compares the 16-bit numbers as signed numbers
+bool foldComparison(Operator op, int left, int right)
+{
+	int l = wrap16(left), r = wrap16(right);
+	switch (op) {
+		case OP_EQUAL:         return l == r;
+		case OP_NOT_EQUAL:     return l != r;
+		case OP_LESS:          return l < r;
+		case OP_LESS_EQUAL:    return l <= r;
+		case OP_GREATER:       return l > r;
+		case OP_GREATER_EQUAL: return l >= r;
+		default:               throw "foldComparison given an operator that isn't a comparison";
+	}
+}
+
+// an operand that code generation won't report as not being an integer, wherever it is
+static bool integerOperand(InferredType type)
+{
+	return type.type == INT_TYPE || type.type == UNKNOWN_TYPE;
+}
+
+// branches that code generation won't report as having different types, wherever they are
+static bool branchTypesMatch(InferredType expriftrue, InferredType expriffalse)
+{
+	return expriftrue == expriffalse || expriftrue.type == UNKNOWN_TYPE || expriffalse.type == UNKNOWN_TYPE;
+}
+
+bool canReplaceIf(InferredType expriftrue, InferredType expriffalse, bool condition)
+{
+	InferredType taken = condition ? expriftrue : expriffalse;
+	return branchTypesMatch(expriftrue, expriffalse) && taken == ifType(expriftrue, expriffalse);
+}
+
+bool ConstantFolding::typeChecks(ExprHandle e) const
+{
+	if (e.isImmediate()) return true;
+	auto found = checked.find(e.node());
+	return found != checked.end() && found->second;
+}
+
+// "e"'s children have already been done (see RewritePass), so this only has to look at them
+ExprHandle ConstantFolding::rewrite(ExprHandle e, NodeFactory &)
+{
+	if (e.isImmediate()) return e;
+	bool ok = true;
+	forEachChild(e, [&](ExprHandle child) { ok = ok && typeChecks(child); });
+
+	switch (e.kind()) {
+		case ARITHMETIC_NODE: {
+			const ArithmeticNode &node = static_cast<const ArithmeticNode &>(*e.node());
+			const ChildList &operands = node.getOperands();
+			if (operands.size() == 2 && operands[0].kind() == INT_LITERAL_NODE && operands[1].kind() == INT_LITERAL_NODE) {
+				return ExprHandle::integer(foldArithmetic(node.getOperator(), operands[0].value(), operands[1].value()));
+			}
+			for (ExprHandle operand : operands) ok = ok && integerOperand(types.resultFor(operand));
+			break;
+		}
+		case COMPARISON_NODE: {
+			const ComparisonNode &node = static_cast<const ComparisonNode &>(*e.node());
+			ExprHandle left = node.getLeft(), right = node.getRight();
+			if (left.kind() == INT_LITERAL_NODE && right.kind() == INT_LITERAL_NODE) {
+				return ExprHandle::boolean(foldComparison(node.getOperator(), left.value(), right.value()));
+			}
+			ok = ok && integerOperand(types.resultFor(left)) && integerOperand(types.resultFor(right));
+			break;
+		}
+		case IF_NODE: {
+			const IfNode &node = static_cast<const IfNode &>(*e.node());
+			ExprHandle condition = node.getCondition();
+			InferredType trueType = types.resultFor(node.getIfTrue()), falseType = types.resultFor(node.getIfFalse());
+			if (condition.kind() == BOOL_LITERAL_NODE && canReplaceIf(trueType, falseType, condition.value())) {
+				ExprHandle taken = condition.value() ? node.getIfTrue() : node.getIfFalse();
+				ExprHandle dropped = condition.value() ? node.getIfFalse() : node.getIfTrue();
+				if (typeChecks(dropped)) return taken;
+			}
+			ok = ok && branchTypesMatch(trueType, falseType);
+			break;
+		}
+		default:
+			break;
+	}
+	checked.emplace(e.node(), ok);
+	return e;
+}
+
+// This goes through the entries in order (children first, as in inferTypes), working out what each one becomes,
+//   then builds the new FlatAST from the root down, leaving out the entries that were folded away.
+// Each entry's type is the same after folding, so "types" is right for the new entries too.
+FlatAST foldConstants(const FlatAST &program)
+{
+	typedef FlatAST::Index Index;
+	std::vector<InferredType> types = inferTypes(program);
+	std::vector<NodeKind> kinds;  // what each entry becomes: a literal, if it was folded
+	std::vector<int> values;      // and then its value
+	std::vector<Index> keep;      // the entry whose subtree takes its place (itself, unless it's an if that was replaced)
+	std::vector<bool> clean;      // whether its subtree can be seen to have no type errors
+	kinds.reserve(program.size());
+	values.reserve(program.size());
+	keep.reserve(program.size());
+	clean.reserve(program.size());
+
+	for (Index i = 0; i < program.size(); i++) {
+		kinds.push_back(program.kind(i));
+		values.push_back(program.payload(i));
+		keep.push_back(i);
+		clean.push_back(true);
+		if (program.isLeaf(i)) continue;
+
+		FlatAST::IndexList children = program.children(i);
+		bool ok = true;
+		for (Index child : children) ok = ok && clean[child];
+		switch (program.kind(i)) {
+			case ARITHMETIC_NODE:
+			case COMPARISON_NODE: {
+				Operator op = Operator(program.payload(i));
+				if (children.size() == 2 && kinds[children[0]] == INT_LITERAL_NODE && kinds[children[1]] == INT_LITERAL_NODE) {
+					int left = values[children[0]], right = values[children[1]];
+					if (program.kind(i) == ARITHMETIC_NODE) {
+						kinds[i] = INT_LITERAL_NODE;
+						values[i] = foldArithmetic(op, left, right);
+					} else {
+						kinds[i] = BOOL_LITERAL_NODE;
+						values[i] = foldComparison(op, left, right);
+					}
+					break;
+				}
+				for (Index child : children) ok = ok && integerOperand(types[child]);
+				break;
+			}
+			case IF_NODE: {
+				Index condition = children[0];
+				if (kinds[condition] == BOOL_LITERAL_NODE && canReplaceIf(types[children[1]], types[children[2]], values[condition])) {
+					Index taken = values[condition] ? children[1] : children[2];
+					Index dropped = values[condition] ? children[2] : children[1];
+					if (clean[dropped]) {
+						kinds[i] = kinds[taken];
+						values[i] = values[taken];
+						keep[i] = keep[taken];
+						ok = clean[taken];
+						break;
+					}
+				}
+				ok = ok && branchTypesMatch(types[children[1]], types[children[2]]);
+				break;
+			}
+			default:
+				break;
+		}
+		clean[i] = ok;
+	}
+
+	FlatAST folded;
+	struct Frame {
+		Index entry;  // in "program"
+		Index first;  // in "folded"
+		FlatAST::IndexList children;
+		std::size_t next;
+	};
+	std::vector<Frame> stack;
+	// add what entry i becomes to "folded", or (if it has children) start on it
+	auto start = [&](Index i) {
+		i = keep[i];
+		if (kinds[i] == INT_LITERAL_NODE || kinds[i] == BOOL_LITERAL_NODE || kinds[i] == VAR_USE_NODE) {
+			folded.addLeaf(kinds[i], values[i]);
+		} else {
+			stack.push_back({ i, folded.size(), program.children(i), 0 });
+		}
+	};
+	start(program.root());
+	while (!stack.empty()) {
+		Frame &frame = stack.back();
+		if (frame.next < frame.children.size()) {
+			start(frame.children[frame.next++]);  // (which may move "frame")
+		} else {
+			Index i = frame.entry;
+			int payload = program.kind(i) == CALL_NODE ? folded.addName(program.name(program.payload(i))) : program.payload(i);
+			folded.addNode(program.kind(i), payload, frame.first);
+			stack.pop_back();
+		}
+	}
+	return folded;
+}
@@ -0,0 +1,52 @@
+#ifndef CONSTANT_FOLDING_H_
+#define CONSTANT_FOLDING_H_
+
+#include <unordered_map>
+#include "AST.h"
+#include "FlatAST.h"
+#include "PassManager.h"
+#include "TypeInference.h"
+
+/*
+ *  Constant folding works out, before code generation, the parts of a program that can't depend on
+ *    anything that happens when it runs: arithmetic and comparisons of integers become integers
+ *    and booleans (e.g. (+ 3 4) becomes 7), and an if whose condition is #t or #f becomes
+ *    the branch it would take.  Since this goes from the bottom of the tree up,
+ *    (* (+ 1 2) (- 5 1)) becomes 12, and (if (<= 1 2) a b) becomes a.
+ *
+ *  The results are just what the HERA code would have given: integers are 16 bits, and wrap around
+ *    (e.g. (* 256 256) is 0), and comparisons are of signed 16-bit numbers, as BL etc. make them.
+ *
+ *  Replacing an if mustn't hide a type error that code generation would have reported, so it's only done
+ *    when the branches' types match (and the if's type is that of the branch that's kept),
+ *    and the branch that's dropped has no type errors that can be seen from its own subtree
+ *    (which rules out e.g. arithmetic on a variable declared outside of it, whose type isn't known there).
+ *  Every expression that's replaced keeps its type, so the results of type inference stay right.
+ */
+
+// the value of arithmetic or a comparison of two integers, as the HERA code would work it out
+//   (these rules are shared by the tree and FlatAST versions below)
+int foldArithmetic(Operator op, int left, int right);
+bool foldComparison(Operator op, int left, int right);
+
+// whether an if with these types of branches, and this condition, can be replaced by the branch it takes
+//   (provided the other one has no type errors of its own)
+bool canReplaceIf(InferredType expriftrue, InferredType expriffalse, bool condition);
+
+// The constant folding pass, for trees; "types" is used to check the types of ifs' branches
+class ConstantFolding : public RewritePass {
+public:
+	ConstantFolding(TypeInference &types) : RewritePass("constant folding"), types(types) { }
+protected:
+	ExprHandle rewrite(ExprHandle e, NodeFactory &nodes);
+private:
+	bool typeChecks(ExprHandle e) const;  // whether e's subtree can be seen to have no type errors
+
+	TypeInference &types;
+	std::unordered_map<const ExprNode *, bool> checked;  // typeChecks for each node rewrite has given back
+};
+
+// The same, for a FlatAST: a copy of "program" with its constants folded
+FlatAST foldConstants(const FlatAST &program);
+
+#endif /*CONSTANT_FOLDING_H_*/
@@ -1,9 +1,9 @@
 #include "ContextInfo.h"
 #include <string.h>
 
-// To provide unique register numbers for each subexpression, with leftmost-executed-first
-//   we'll start with 1 at the root, make the rightmost child's number same as its parent,
-//   and make each other child one more than the sibling to its right.
+// To provide unique register numbers for each subexpression, we start with maxRegNum at the root,
+//   give the child that's evaluated first the same number as its parent, and each later child
+//   one less than the one before it (see RegisterNeeds.h for which child goes first).
 
 static const int minRegNum= 1;  // Lowest  register number we're going to use
 static const int maxRegNum=10;  // Highest register number we're going to use
@@ -29,18 +29,37 @@ ContextInfo ContextInfo::evalThisAfter() const
 	return ContextInfo(this->myRegNumber-1);
 }
 
+int ContextInfo::registersLeft() const
+{
+	return myRegNumber - minRegNum + 1;
+}
+
 std::string ContextInfo::getReg() const
 {
 	return "R"+std::to_string(myRegNumber);
 }
 
-std::string ContextInfo::labelfunc() const
+// (the first letter drawn is the last letter of the name, as it always has been)
+int ContextInfo::labelfunc()
+{
+    int label = 0;
+    for (int place = 1; place < 26 * 26 * 26 * 26; place *= 26) {
+        label += place * (random() % 26);
+    }
+    return label;
+}
+
+std::string ContextInfo::labelName(int label)
 {
-    std::string label = "";
-    return label + labeler[random() % 26] + labeler[random() % 26] + labeler[random() % 26] + labeler[random() % 26];
+    std::string name(4, ' ');
+    for (int letter = 3; letter >= 0; letter--) {
+        name[letter] = labeler[label % 26];
+        label /= 26;
+    }
+    return name;
 }
 
 std::string ContextInfo::getLabel() const
 {
-    return label;
+    return labelName(label);
 }
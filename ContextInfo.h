@@ -8,15 +8,21 @@ public:
 	ContextInfo evalThisAfter() const; // create another context for something to be evaluated later
 
 	std::string getReg() const;
-	std::string labelfunc() const;
+	int getRegNumber() const { return myRegNumber; }
+	int registersLeft() const;  // how many registers there are for this, i.e. its own and the ones below it
     std::string getLabel() const;
+    int getLabelNumber() const { return label; }  // see labelName
+
+    // the name of a label, e.g. "qwer"; each label's number is its four letters as a base-26 number
+    static std::string labelName(int label);
 private:
 	// "myRegNumber" will tell each expression what register number they should use for their result
 	//  should generally be different for the subexpressions of a node,
 	//  and if X is evalualuated before Y, it should have a higher number.
 
 	ContextInfo(int myRegNum);  // called by e.g. evalThisFirst, to build new contexts
+	static int labelfunc();     // a new, random, label number
 	int myRegNumber;
-	std::string label = labelfunc();
+	int label = labelfunc();
 };
 #endif //CONTEXT_INFO
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <unordered_map>
+#include "CostModel.h"
+
+int takenBranchCycles()
+{
+	static const int cycles = [] {
+		const char *setting = getenv("HAVERRACKET_TAKEN_BRANCH_CYCLES");
+		return setting && atoi(setting) > 0 ? atoi(setting) : 2;
+	}();
+	return cycles;
+}
+
+// the cycles an instruction takes, if it isn't a branch that's taken
+static int cycles(HERAOpcode opcode)
+{
+	switch (opcode) {
+		case HERA_LOAD:
+		case HERA_STORE: return 2;
+		case HERA_CALL:  return 3;
+		case HERA_LABEL: return 0;
+		case HERA_BR:    return takenBranchCycles();  // (which is always taken)
+		default:         return 1;
+	}
+}
+
+// This goes through the code once, keeping the chance of getting to each instruction:
+//   a conditional branch sends half of its chance on to its label, and BR all of it
+//   (a label collects the chances of the branches to it, as well as that of falling into it).
+double expectedCycles(const HERACode &code)
+{
+	std::unordered_map<int, double> toLabel;  // the chance of branching to each label
+	double chance = 1.0;                      // of getting to the next instruction
+	double total = 0.0;
+	for (std::size_t i = 0; i < code.size(); i++) {
+		const HERAInstruction &in = code[i];
+		switch (in.opcode) {
+			case HERA_LABEL:
+				chance += toLabel[in.value];
+				toLabel[in.value] = 0.0;
+				break;
+			case HERA_BR:
+				total += chance * cycles(HERA_BR);
+				toLabel[in.value] += chance;
+				chance = 0.0;
+				break;
+			case HERA_BZ:
+			case HERA_BNZ:
+			case HERA_BS:
+			case HERA_BL:
+			case HERA_BGE:
+			case HERA_BLE:
+			case HERA_BG:
+				total += chance * (takenBranchCycles() + cycles(in.opcode)) / 2;
+				toLabel[in.value] += chance / 2;
+				chance /= 2;
+				break;
+			default:
+				total += chance * cycles(in.opcode);
+		}
+	}
+	return total;
+}
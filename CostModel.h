@@ -0,0 +1,22 @@
+#ifndef COST_MODEL_H_
+#define COST_MODEL_H_
+
+#include "HERACode.h"
+
+/*
+ *  The cost model estimates how long some HERACode takes to run, so that code generation can choose
+ *    between two ways of doing the same thing, e.g. with branches or without (see generateHERA.cc).
+ *
+ *  Each instruction takes one cycle, except LOAD and STORE (two), CALL (three), LABEL (none),
+ *    and a branch that's taken, which takes takenBranchCycles(): two, unless HAVERRACKET_TAKEN_BRANCH_CYCLES
+ *    says otherwise (e.g. for a HERA whose pipeline has more to throw away when it branches).
+ *  Since the compiler can't know which way a conditional branch will go, it's taken half of the time.
+ */
+
+int takenBranchCycles();
+
+// the number of cycles "code" is expected to take, run from its first instruction
+//   (it mustn't branch backward; a branch to a label that isn't in "code" leaves it)
+double expectedCycles(const HERACode &code);
+
+#endif /*COST_MODEL_H_*/
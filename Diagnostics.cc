@@ -0,0 +1,11 @@
+#include "Diagnostics.h"
+
+Diagnostics::Diagnostics(std::ostream &echoTo) : echo(echoTo)
+{
+}
+
+void Diagnostics::report(int exitCode, const std::string &message)
+{
+	reported.push_back(Diagnostic{exitCode, message});
+	echo << message << std::endl;
+}
@@ -0,0 +1,40 @@
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ *  A Diagnostics object collects the error messages for a compilation,
+ *    so that the parser and code generator can report a problem and keep going
+ *    (rather than calling "exit", which would end a batch of compilations, or a compile server).
+ *
+ *  Each message is also written to a stream (cerr by default) as soon as it's reported.
+ *  Each has an "exit code", the status the compiler used to exit with for that problem,
+ *    so that main can still return the same status for a single program.
+ */
+
+class Diagnostics {
+public:
+	struct Diagnostic {
+		int exitCode;
+		std::string message;
+	};
+
+	Diagnostics(std::ostream &echoTo = std::cerr);
+
+	void report(int exitCode, const std::string &message);
+
+	bool any() const { return !reported.empty(); }
+	int count() const { return reported.size(); }
+	int firstExitCode() const { return any() ? reported[0].exitCode : 0; }  // 0 if there were no problems
+	const std::vector<Diagnostic> &all() const { return reported; }
+
+	void clear() { reported.clear(); }  // e.g. before the next program in a batch
+private:
+	std::ostream &echo;
+	std::vector<Diagnostic> reported;
+};
+
+#endif /*DIAGNOSTICS_H_*/
@@ -10,7 +10,7 @@
  *
  * @return true or false
  */
-bool Dictionary::containsHelper (const list<pair<string,int>> &dList, const string &entry) {
+bool Dictionary::containsHelper (const list<pair<SymbolID, int>> &dList, SymbolID entry) {
     if (empty(dList)) {
         return false;
     }
@@ -27,7 +27,7 @@ bool Dictionary::containsHelper (const list<pair<string,int>> &dList, const stri
  *
  * @return true or false
  */
-bool Dictionary::contains (const string &entry) {
+bool Dictionary::contains (SymbolID entry) {
     return containsHelper(getList(), entry);
 }
 
@@ -35,11 +35,11 @@ bool Dictionary::contains (const string &entry) {
 /**
  * method that recurses through dictionary until it finds and returns integer assigned to entry
  *
- * @param entry string being looked up
+ * @param entry symbol being looked up
  * @param dList dictionary data field
  * @return the integer
  */
-int Dictionary::lookupHelper (const list<pair<string,int>> &dList, const string &entry) {
+int Dictionary::lookupHelper (const list<pair<SymbolID, int>> &dList, SymbolID entry) {
     if (empty(dList)) {
         return -1;
     }
@@ -52,10 +52,10 @@ int Dictionary::lookupHelper (const list<pair<string,int>> &dList, const string
 /**
  * method that checks the integer assigned to entry of dictionary
  *
- * @param entry string being looked up
+ * @param entry symbol being looked up
  * @return the integer
  */
-int Dictionary::lookup (const string &entry) {
+int Dictionary::lookup (SymbolID entry) {
     return lookupHelper(getList(), entry);
 }
 
@@ -68,11 +68,11 @@ string Dictionary::toCode () {
     if (empty(dictList)) {
         return "Dictionary()\n";
     }
-    list<pair<string, int>> temp = dictList;
+    list<pair<SymbolID, int>> temp = dictList;
     string dictCode = "Dictionary()";
     for (int i = 0; i < length(dictList); i++) {
         // learnt to_string for int to string from http://www.cplusplus.com/reference/string/to_string/
-        dictCode = "Dictionary(" + dictCode + ", \"" + get<0>(first(temp)) + "\", " + to_string(get<1>(first(temp))) +
+        dictCode = "Dictionary(" + dictCode + ", " + to_string(get<0>(first(temp))) + ", " + to_string(get<1>(first(temp))) +
                 ")";
         temp = rest(temp);
     }
@@ -82,11 +82,11 @@ string Dictionary::toCode () {
 /**
  * method that adds new entry to dictionary by constructing new data field
  *
- * @param entry string to be added
+ * @param entry symbol to be added
  * @param integer integer assigned to the string
  */
-void Dictionary::add (string entry, int integer) {
-    list<pair<string, int>> newList = list<pair<string, int>>(pair<string, int>(entry, integer), dictList);
+void Dictionary::add (SymbolID entry, int integer) {
+    list<pair<SymbolID, int>> newList = list<pair<SymbolID, int>>(pair<SymbolID, int>(entry, integer), dictList);
     dictList = newList;
 }
 
@@ -96,7 +96,7 @@ void Dictionary::add (string entry, int integer) {
  *
  * @return true if successful
  */
-bool Dictionary::replaceHelper (list<pair<string, int>> newList, list<pair<string,int>> dList, const string &entry, int
+bool Dictionary::replaceHelper (list<pair<SymbolID, int>> newList, list<pair<SymbolID, int>> dList, SymbolID entry, int
 integer) {
     if (empty(dList)) {
         // finished recursion, now replace dictionary data field
@@ -104,11 +104,11 @@ integer) {
         return true;
     }
     if ((get<0>(head(dList)) == entry)) {
-        newList = list<pair<string, int>>(pair<string, int>(get<0>(head(dList)), integer), newList);
+        newList = list<pair<SymbolID, int>>(pair<SymbolID, int>(get<0>(head(dList)), integer), newList);
         // continue recursing to build the rest of the dictionary
         return replaceHelper(newList, rest(dList), entry, integer);
     }
-    newList = list<pair<string, int>>(head(dList), newList);
+    newList = list<pair<SymbolID, int>>(head(dList), newList);
     return replaceHelper(newList, rest(dList), entry, integer);
 }
 
@@ -117,8 +117,8 @@ integer) {
  *
  * @return true if the replacement was successful
  */
-bool Dictionary::replace (const string &entry, int integer) {
-    replaceHelper(list<pair<string, int>>(), getList(), entry, integer);
+bool Dictionary::replace (SymbolID entry, int integer) {
+    replaceHelper(list<pair<SymbolID, int>>(), getList(), entry, integer);
 }
 
 
@@ -8,12 +8,14 @@
 #include <hc_list.h>
 #include <hc_list_helpers.h>
 #include <utility>
+#include "SymbolTable.h"
 
 using namespace HaverfordCS;
 using namespace std;
 
 /**
- * class that instantiates dictionary with string : integer entries
+ * class that instantiates dictionary with symbol : integer entries,
+ * where each symbol is a variable name's SymbolID (see SymbolTable.h)
  *
  * @author Keith Mburu
  * @version 3/24/2021
@@ -26,18 +28,18 @@ public:
      * constructor method for empty dictionary
      */
     Dictionary() {
-        dictList = list<std::pair<string,int>>();
+        dictList = list<std::pair<SymbolID, int>>();
     }
 
     /**
      * constructor method for new dictionary with old dictionary plus new entry
      *
      * @param oldDict old dictionary
-     * @param entry string to be added to old dictionary
+     * @param entry symbol to be added to old dictionary
      * @param integer integer to be assigned to new entry
      */
-    Dictionary(const Dictionary &oldDict, const string &entry, const int &integer) {
-        dictList = list<pair<string,int>>(pair<string,int>(entry, integer), oldDict.dictList);
+    Dictionary(const Dictionary &oldDict, SymbolID entry, const int &integer) {
+        dictList = list<pair<SymbolID, int>>(pair<SymbolID, int>(entry, integer), oldDict.dictList);
     }
 
     /**
@@ -45,7 +47,7 @@ public:
      *
      * @return list that stores dictionary data
      */
-    list<pair<string,int>> getList() {
+    list<pair<SymbolID, int>> getList() {
         return dictList;
     }
 
@@ -54,7 +56,7 @@ public:
      *
      * @param newList list to replace dictionary list
      */
-    void setList(list<pair<string, int>> newList) {
+    void setList(list<pair<SymbolID, int>> newList) {
         dictList = newList;
     }
 
@@ -65,11 +67,11 @@ public:
      *
      * @return string containing dictionary entries
      */
-    string toStringHelper(const list<pair<string,int>> &dictList, string dictString) {
+    string toStringHelper(const list<pair<SymbolID, int>> &dictList, string dictString) {
         if (empty(rest(dictList))) {
-            return dictString += get<0>(head(dictList)) + " : " + to_string(get<1>(head(dictList)));
+            return dictString += to_string(get<0>(head(dictList))) + " : " + to_string(get<1>(head(dictList)));
         }
-        dictString += get<0>(head(dictList)) + " : " + to_string(get<1>(head(dictList))) + "\n";
+        dictString += to_string(get<0>(head(dictList))) + " : " + to_string(get<1>(head(dictList))) + "\n";
         return toStringHelper(rest(dictList), dictString);
     }
 
@@ -83,18 +85,18 @@ public:
     }
 
     // other methods defined in Dictionary.cpp
-    int lookup (const string &entry);
-    int lookupHelper (const list<pair<string,int>> &dList, const string &entry);
-    bool contains (const string &entry);
-    bool containsHelper (const list<pair<string,int>> &dList, const string &entry);
-    void add (string entry, int integer);
-    bool replace (const string &entry, int integer);
-    bool replaceHelper (list<pair<string, int>> newList, list<pair<string,int>> dList, const string &entry, int integer);
+    int lookup (SymbolID entry);
+    int lookupHelper (const list<pair<SymbolID, int>> &dList, SymbolID entry);
+    bool contains (SymbolID entry);
+    bool containsHelper (const list<pair<SymbolID, int>> &dList, SymbolID entry);
+    void add (SymbolID entry, int integer);
+    bool replace (SymbolID entry, int integer);
+    bool replaceHelper (list<pair<SymbolID, int>> newList, list<pair<SymbolID, int>> dList, SymbolID entry, int integer);
     string toCode ();
 
 private:
 
-    list<pair<string,int>> dictList; // list that stores dictionary data
+    list<pair<SymbolID, int>> dictList; // list that stores dictionary data
 
 };
 
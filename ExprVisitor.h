@@ -0,0 +1,107 @@
+#ifndef EXPR_VISITOR_H_
+#define EXPR_VISITOR_H_
+
+#include "AST.h"
+
+/*
+ *  An ExprVisitor<Result> does something different for each kind of expression, giving back a Result,
+ *    without a new virtual method in every ExprNode class for each new thing we want to do to a tree
+ *    (generateHERA is the only one of those, and should stay the only one).
+ *  "visit" picks the method to call with a switch on the expression's NodeKind,
+ *    so an immediate (see ExprHandle in AST.h) is visited without there being any node for it.
+ *  Each visitor decides for itself whether to visit the children, and in what order;
+ *    see PassManager.h for visitors that work out a result for every node of a tree.
+ */
+
+// C++ Usage Note: a "template" class is really a family of classes, one for each Result type,
+//   all written at once; since the compiler writes each one as it's needed, a template's
+//   methods all have to be in the header file, rather than in a .cc file.
+
+template <typename Result>
+class ExprVisitor {
+public:
+	virtual ~ExprVisitor() = default;
+
+	Result visit(ExprHandle e)  // precondition: !e.isNull()
+	{
+		switch (e.kind()) {
+			case INT_LITERAL_NODE:  return visitInteger(e.value());
+			case BOOL_LITERAL_NODE: return visitBoolean(e.value() != 0);
+			case VAR_USE_NODE:      return visitVariable(e.value());
+			case COMPARISON_NODE:   return visitComparison(*static_cast<const ComparisonNode *>(e.node()));
+			case ARITHMETIC_NODE:   return visitArithmetic(*static_cast<const ArithmeticNode *>(e.node()));
+			case CALL_NODE:         return visitCall(*static_cast<const CallNode *>(e.node()));
+			case IF_NODE:           return visitIf(*static_cast<const IfNode *>(e.node()));
+			case LET_NODE:          return visitLet(*static_cast<const LetNode *>(e.node()));
+			case DECLARATIONS_NODE: return visitDeclarations(*static_cast<const DeclarationsNode *>(e.node()));
+			case DECLARATION_NODE:  return visitDeclaration(*static_cast<const DeclarationNode *>(e.node()));
+			default:                throw "ExprVisitor::visit given a node of unknown kind";
+		}
+	}
+
+protected:
+	virtual Result visitInteger(int value) = 0;
+	virtual Result visitBoolean(bool value) = 0;
+	virtual Result visitVariable(SymbolID variable) = 0;
+	virtual Result visitComparison(const ComparisonNode &node) = 0;
+	virtual Result visitArithmetic(const ArithmeticNode &node) = 0;
+	virtual Result visitCall(const CallNode &node) = 0;
+	virtual Result visitIf(const IfNode &node) = 0;
+	virtual Result visitLet(const LetNode &node) = 0;
+	virtual Result visitDeclarations(const DeclarationsNode &node) = 0;
+	virtual Result visitDeclaration(const DeclarationNode &node) = 0;
+};
+
+// call f(child) for each child of "e", in order (for a LetNode, its DeclarationsNode comes first);
+//   immediates have no children, and null children (from syntax errors) are skipped
+template <typename F>
+void forEachChild(ExprHandle e, F f)
+{
+	if (e.isNull() || e.isImmediate()) return;
+	auto each = [&](ExprHandle child) { if (!child.isNull()) f(child); };
+	switch (e.kind()) {
+		case COMPARISON_NODE: {
+			const ComparisonNode *node = static_cast<const ComparisonNode *>(e.node());
+			each(node->getLeft());
+			each(node->getRight());
+			break;
+		}
+		case ARITHMETIC_NODE:
+			for (ExprHandle child : static_cast<const ArithmeticNode *>(e.node())->getOperands()) each(child);
+			break;
+		case CALL_NODE:
+			for (ExprHandle child : static_cast<const CallNode *>(e.node())->getArguments()) each(child);
+			break;
+		case IF_NODE: {
+			const IfNode *node = static_cast<const IfNode *>(e.node());
+			each(node->getCondition());
+			each(node->getIfTrue());
+			each(node->getIfFalse());
+			break;
+		}
+		case LET_NODE: {
+			const LetNode *node = static_cast<const LetNode *>(e.node());
+			each(node->getDeclarations());
+			for (ExprHandle child : node->getExpressions()) each(child);
+			break;
+		}
+		case DECLARATIONS_NODE:
+			for (ExprHandle child : static_cast<const DeclarationsNode *>(e.node())->getDeclarations()) each(child);
+			break;
+		case DECLARATION_NODE:
+			each(static_cast<const DeclarationNode *>(e.node())->getValue());
+			break;
+		default:
+			throw "forEachChild given a node of unknown kind";
+	}
+}
+
+// the children of "e", in the order forEachChild gives them
+inline ChildList childrenOf(ExprHandle e)
+{
+	ChildList children;
+	forEachChild(e, [&](ExprHandle child) { children.push_back(child); });
+	return children;
+}
+
+#endif /*EXPR_VISITOR_H_*/
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "FlatAST.h"
+
+FlatAST::FlatAST(const FlatAST &other) :
+	count(other.count),
+	budget(other.budget),
+	kinds(other.kinds),
+	payloads(other.payloads),
+	firsts(other.firsts),
+	names(other.names),
+	file(other.file)
+{
+	if (file) {
+		kindArray = other.kindArray;
+		payloadArray = other.payloadArray;
+		firstArray = other.firstArray;
+	} else {
+		useVectors();
+	}
+}
+
+FlatAST &FlatAST::operator=(const FlatAST &other)
+{
+	if (this != &other) {
+		FlatAST copy(other);
+		*this = std::move(copy);
+	}
+	return *this;
+}
+
+void FlatAST::useVectors()
+{
+	kindArray = kinds.data();
+	payloadArray = payloads.data();
+	firstArray = firsts.data();
+	count = kinds.size();
+}
+
+int FlatAST::addName(const std::string &name)
+{
+	for (std::size_t n = 0; n < names.size(); n++) {
+		if (names[n] == name) return n;
+	}
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+// The last child ends right before the node, and each child's subtree starts
+//   right after the one before it ends, so we find them from right to left
+FlatAST::IndexList FlatAST::children(Index i) const
+{
+	IndexList result;
+	for (Index child = i; child > first(i); child = first(child - 1)) {
+		result.push_back(child - 1);
+	}
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+void FlatAST::truncate(Index newSize)
+{
+	if (newSize < size()) {
+		kinds.resize(newSize);
+		payloads.resize(newSize);
+		firsts.resize(newSize);
+		useVectors();
+	}
+}
+
+void FlatAST::clear()
+{
+	file.reset();
+	kinds.clear();
+	payloads.clear();
+	firsts.clear();
+	names.clear();
+	useVectors();
+}
+
+
+// The file format, all in the byte order of the machine that wrote it:
+//   a FileHeader (below)
+//   the kinds, one byte each, followed by 0s up to a multiple of 4 bytes
+//   the payloads, 4 bytes each
+//   the "first"s, 4 bytes each
+//   the function names, then the variable names (in SymbolID order),
+//     each as a 4-byte length followed by that many characters
+// so the arrays start at multiples of 4 bytes from the start of the file, and can be used right where they are.
+// Change FORMAT_VERSION whenever this (or NodeKind, or what a payload means) changes.
+
+static const char MAGIC[8] = { 'H', 'R', 'K', 'F', 'L', 'A', 'T', '\n' };
+static const std::uint32_t FORMAT_VERSION = 1;
+static const std::uint32_t BYTE_ORDER_CHECK = 0x01020304;  // reads differently in the other byte order
+
+namespace {
+struct FileHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byteOrder;
+	std::uint32_t entries;
+	std::uint32_t nameCount;    // function names
+	std::uint32_t symbolCount;  // variable names
+	std::uint32_t unused;       // (0, to make the header a multiple of 8 bytes)
+};
+}
+static_assert(sizeof(FileHeader) == 32, "the FileHeader has no padding");
+static_assert(sizeof(NodeKind) == 1 && sizeof(int) == 4, "the file has kinds in 1 byte and payloads in 4");
+
+static std::size_t kindBytes(std::size_t entries)
+{
+	return (entries + 3) / 4 * 4;
+}
+
+static void writeString(std::ofstream &out, std::string_view text)
+{
+	std::uint32_t length = text.length();
+	out.write(reinterpret_cast<const char *>(&length), sizeof length);
+	out.write(text.data(), length);
+}
+
+bool FlatAST::save(const char *path, const SymbolTable &symbols) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out) return false;
+
+	FileHeader header;
+	std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+	header.version = FORMAT_VERSION;
+	header.byteOrder = BYTE_ORDER_CHECK;
+	header.entries = count;
+	header.nameCount = names.size();
+	header.symbolCount = symbols.size();
+	header.unused = 0;
+	out.write(reinterpret_cast<const char *>(&header), sizeof header);
+
+	static const char zeros[4] = { 0, 0, 0, 0 };
+	out.write(reinterpret_cast<const char *>(kindArray), count);
+	out.write(zeros, kindBytes(count) - count);
+	out.write(reinterpret_cast<const char *>(payloadArray), count * sizeof(int));
+	out.write(reinterpret_cast<const char *>(firstArray), count * sizeof(Index));
+
+	for (const std::string &name : names) {
+		writeString(out, name);
+	}
+	for (SymbolID id = 0; id < symbols.size(); id++) {
+		writeString(out, symbols.name(id));
+	}
+	return bool(out.flush());
+}
+
+// check that entry i of a loaded FlatAST makes sense, so code generation can trust it;
+//   the entries before it have already been checked
+static bool validEntry(const FlatAST &program, FlatAST::Index i, std::uint32_t nameCount, std::uint32_t symbolCount)
+{
+	NodeKind kind = program.kind(i);
+	if (kind >= NUMBER_OF_NODE_KINDS || program.first(i) > i) return false;
+	bool validVariable = program.payload(i) >= 0 && std::uint32_t(program.payload(i)) < symbolCount;
+	if (program.isLeaf(i)) return program.first(i) == i && (kind != VAR_USE_NODE || validVariable);
+
+	std::size_t children = 0;
+	FlatAST::Index firstChild = i;     // (the last one the loop gets to)
+	bool allDeclarations = true;
+	for (FlatAST::Index child = i; child > program.first(i); child = program.first(child - 1)) {
+		if (program.first(child - 1) < program.first(i)) return false;  // that child doesn't fit inside this node
+		children++;
+		firstChild = child - 1;
+		allDeclarations = allDeclarations && program.kind(firstChild) == DECLARATION_NODE;
+	}
+	switch (kind) {
+		case COMPARISON_NODE:   return children == 2 && program.payload(i) >= OP_EQUAL && program.payload(i) <= OP_NOT_EQUAL;
+		case IF_NODE:           return children == 3;
+		case DECLARATION_NODE:  return children == 1 && validVariable;
+		case DECLARATIONS_NODE: return allDeclarations;
+		case ARITHMETIC_NODE:   return children >= 1 && program.payload(i) >= OP_PLUS && program.payload(i) <= OP_TIMES;
+		case LET_NODE:          return children >= 1 && program.kind(firstChild) == DECLARATIONS_NODE;
+		case CALL_NODE:         return std::uint32_t(program.payload(i)) < nameCount;
+		default:                return true;
+	}
+}
+
+bool FlatAST::load(const char *path, Diagnostics &problems, SymbolTable &symbols)
+{
+	auto mapped = std::make_shared<MappedFile>(path);
+	if (!mapped->ok()) {
+		problems.report(1, std::string("can't read ") + path);
+		return false;
+	}
+	const char *data = mapped->data();
+	std::size_t size = mapped->size();
+	const std::string notOne = std::string(path) + " isn't an AST saved by this version of the compiler";
+
+	FileHeader header;
+	if (size < sizeof header) {
+		problems.report(1, notOne);
+		return false;
+	}
+	std::memcpy(&header, data, sizeof header);
+	std::size_t arrays = kindBytes(header.entries) + header.entries * (sizeof(int) + sizeof(Index));
+	if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 || header.version != FORMAT_VERSION ||
+	    header.byteOrder != BYTE_ORDER_CHECK || header.entries == 0 || size < sizeof header + arrays) {
+		problems.report(1, notOne);
+		return false;
+	}
+
+	FlatAST loaded;
+	loaded.file = mapped;
+	loaded.count = header.entries;
+	loaded.kindArray = reinterpret_cast<const NodeKind *>(data + sizeof header);
+	loaded.payloadArray = reinterpret_cast<const int *>(data + sizeof header + kindBytes(header.entries));
+	loaded.firstArray = reinterpret_cast<const Index *>(data + sizeof header + kindBytes(header.entries) + header.entries * sizeof(int));
+
+	// then the strings
+	std::size_t at = sizeof header + arrays;
+	std::vector<std::string_view> strings;
+	for (std::uint32_t s = 0; s < header.nameCount + header.symbolCount; s++) {
+		std::uint32_t length;
+		if (size - at < sizeof length) break;
+		std::memcpy(&length, data + at, sizeof length);
+		at += sizeof length;
+		if (size - at < length) break;
+		strings.emplace_back(data + at, length);
+		at += length;
+	}
+	bool valid = strings.size() == header.nameCount + header.symbolCount && loaded.first(loaded.root()) == 0;
+	for (Index i = 0; valid && i < loaded.count; i++) {
+		valid = validEntry(loaded, i, header.nameCount, header.symbolCount);
+	}
+	if (!valid) {
+		problems.report(1, std::string(path) + " is damaged");
+		return false;
+	}
+
+	for (std::uint32_t n = 0; n < header.nameCount; n++) {
+		loaded.names.emplace_back(strings[n]);
+	}
+	for (std::uint32_t s = 0; s < header.symbolCount; s++) {
+		symbols.intern(strings[header.nameCount + s]);
+	}
+	*this = std::move(loaded);
+	return true;
+}
@@ -0,0 +1,120 @@
+#ifndef FLAT_AST_H_
+#define FLAT_AST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AST.h"
+#include "SmallVector.h"
+#include "SymbolTable.h"
+#include "Diagnostics.h"
+#include "MappedFile.h"
+#include "HERACode.h"
+
+/*
+ *  A FlatAST is another way to hold a program's tree: rather than ExprNode objects
+ *    that point to each other, it's a few parallel arrays, with one entry per node
+ *    (including the integer, boolean, and variable leaves), in postorder,
+ *    i.e. each node comes right after its last child, and the root is the last entry.
+ *
+ *  For each entry we keep its NodeKind, a "payload" that depends on the kind:
+ *	INT_LITERAL_NODE, BOOL_LITERAL_NODE:    the value (0 or 1 for booleans)
+ *	VAR_USE_NODE:                           the variable's SymbolID
+ *	ARITHMETIC_NODE, COMPARISON_NODE:       the Operator
+ *	CALL_NODE:                              the index of the function's name (see "name")
+ *	DECLARATION_NODE:                       the SymbolID of the variable being declared
+ *	IF_NODE, LET_NODE, DECLARATIONS_NODE:   0
+ *    and the index of the first entry of its subtree (its own index, if it has no children),
+ *    so a node's subtree is all the entries from "first" to the node itself.
+ *
+ *  The parser can build one directly (see parser.h), in the order it finishes each node,
+ *    and generateFullHERA can walk it with a loop, rather than by calling itself.
+ *  Since it's just arrays, with no pointers, a FlatAST can be copied (e.g. to another thread) as it is.
+ *
+ *  For the same reason, it can be saved in a file just as it is in memory (see "save" for the format),
+ *    and "load" then maps that file into memory and uses the arrays right where they are,
+ *    so compiling a program again (e.g. with different options) doesn't need to lex or parse it again.
+ *    (A loaded FlatAST can't be added to, though.)
+ */
+
+class FlatAST {
+public:
+	typedef std::uint32_t Index;
+	typedef SmallVector<Index, 4> IndexList;
+
+	FlatAST() { }
+	// a FlatAST whose entries may take at most "budget" bytes (0 means no limit), like an Arena's budget:
+	//   adding an entry past that throws a "const char *" message
+	explicit FlatAST(std::size_t budget) : budget(budget) { }
+	FlatAST(const FlatAST &other);
+	FlatAST &operator=(const FlatAST &other);
+	FlatAST(FlatAST &&other) = default;  // C++ Usage Note: moving a vector keeps its array where it is, so this is fine
+	FlatAST &operator=(FlatAST &&other) = default;
+
+	// add a leaf: INT_LITERAL_NODE, BOOL_LITERAL_NODE, or VAR_USE_NODE
+	Index addLeaf(NodeKind kind, int payload) { return add(kind, payload, size()); }
+	// add a node whose children are the subtrees from entry "first" to the end, in order
+	Index addNode(NodeKind kind, int payload, Index first) { return add(kind, payload, first); }
+	// the index of a function name (for the payload of a CALL_NODE), adding it if it's new
+	int addName(const std::string &name);
+
+	Index size() const { return count; }
+	bool empty() const { return count == 0; }
+	Index root() const { return size() - 1; }  // precondition: !empty()
+
+	// precondition for these: i < size()
+	NodeKind kind(Index i) const { return kindArray[i]; }
+	int payload(Index i) const { return payloadArray[i]; }
+	Index first(Index i) const { return firstArray[i]; }
+	bool isLeaf(Index i) const { return kind(i) == INT_LITERAL_NODE || kind(i) == BOOL_LITERAL_NODE || kind(i) == VAR_USE_NODE; }
+	IndexList children(Index i) const;  // in order, left to right
+
+	const std::string &name(int n) const { return names[n]; }
+
+	void truncate(Index newSize);  // forget everything after the first newSize entries
+	void clear();                  // (this also forgets the file, if it was loaded from one)
+
+	// write this FlatAST to a file, along with the names of the variables from the program's SymbolTable;
+	//   return false if the file can't be written
+	bool save(const char *path, const SymbolTable &symbols) const;
+	// replace this FlatAST with the one in a file written by "save", and add its variables' names to "symbols"
+	//   (which should be empty, so they get the same SymbolIDs as before);
+	//   if the file can't be read, or isn't one that "save" wrote, report that to "problems" and return false
+	bool load(const char *path, Diagnostics &problems, SymbolTable &symbols);
+private:
+	static const std::size_t ENTRY_BYTES = sizeof(NodeKind) + sizeof(int) + sizeof(Index);
+
+	Index add(NodeKind kind, int payload, Index first)
+	{
+		if (budget != 0 && (std::size_t(count) + 1) * ENTRY_BYTES > budget) {
+			throw "the program needs more memory than the AST budget allows";  // (as an Arena says)
+		}
+		kinds.push_back(kind);
+		payloads.push_back(payload);
+		firsts.push_back(first);
+		useVectors();
+		return count - 1;
+	}
+	void useVectors();
+
+	// the arrays: either the data of the vectors below, or in "file"
+	const NodeKind *kindArray = nullptr;
+	const int *payloadArray = nullptr;
+	const Index *firstArray = nullptr;
+	Index count = 0;
+	std::size_t budget = 0;
+
+	std::vector<NodeKind> kinds;
+	std::vector<int> payloads;
+	std::vector<Index> firsts;
+	std::vector<std::string> names;  // of the functions called, e.g. "getint"
+	std::shared_ptr<MappedFile> file;  // (shared, since copies of a loaded FlatAST all use the same file)
+};
+
+// generate the code for a whole program (see generateHERA.cc), as for the tree versions in AST.h
+std::string generateFullHERA(const FlatAST &program, Diagnostics &problems);
+HERACode generateHERACode(const FlatAST &program, Diagnostics &problems);
+
+#endif /*FLAT_AST_H_*/
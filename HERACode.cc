@@ -0,0 +1,113 @@
+#include "HERACode.h"
+#include "ContextInfo.h"
+
+// This table is indexed by HERAOpcode, so keep it in the same order as that enum
+static const char *const opcodeNames[] = {
+	"CBON", "SET", "LOAD", "STORE",
+	"ADD", "SUB", "MUL", "AND", "OR", "XOR", "LSR",
+	"CMP", "MOVE", "FLAGS", "SAVEF",
+	"BZ", "BNZ", "BS", "BL", "BGE", "BLE", "BG", "BR",
+	"LABEL", "CALL"
+};
+static_assert(sizeof opcodeNames / sizeof opcodeNames[0] == NUMBER_OF_HERA_OPCODES, "a name for each opcode");
+
+const char *opcodeName(HERAOpcode opcode)
+{
+	return opcodeNames[opcode];
+}
+
+// a register's name, e.g. "R3", or "FP" for 14
+static CodeBuffer &operator<<(CodeBuffer &text, HERARegister reg)
+{
+	switch (reg) {
+		case FP_ALT: return text << "FP_alt";
+		case FP:     return text << "FP";
+		case SP:     return text << "SP";
+		default:     return text << 'R' << int(reg);
+	}
+}
+
+static HERARegister r(std::uint8_t reg)
+{
+	return HERARegister(reg);
+}
+
+int HERACode::function(const std::string &name)
+{
+	for (std::size_t f = 0; f < functions.size(); f++) {
+		if (functions[f] == name) return f;
+	}
+	functions.push_back(name);
+	return functions.size() - 1;
+}
+
+void HERACode::append(const HERACode &other)
+{
+	for (HERAInstruction i : other.instructions) {
+		if (i.opcode == HERA_CALL) i.value = function(other.functionName(i.value));
+		instructions.push_back(i);
+	}
+}
+
+void HERACode::render(CodeBuffer &text) const
+{
+	for (const HERAInstruction &i : instructions) {
+		text << opcodeNames[i.opcode] << '(';
+		switch (i.opcode) {
+			case HERA_CBON:
+				break;
+			case HERA_SET:
+				text << r(i.d) << ", " << i.value;
+				break;
+			case HERA_LOAD:
+			case HERA_STORE:
+				text << r(i.d) << ", " << i.value << ", " << r(i.a);
+				break;
+			case HERA_ADD:
+			case HERA_SUB:
+			case HERA_MUL:
+			case HERA_AND:
+			case HERA_OR:
+			case HERA_XOR:
+				text << r(i.d) << ", " << r(i.a) << ", " << r(i.b);
+				break;
+			case HERA_CMP:
+				text << r(i.a) << ", " << r(i.b);
+				break;
+			case HERA_LSR:
+			case HERA_MOVE:
+				text << r(i.d) << ", " << r(i.a);
+				break;
+			case HERA_FLAGS:
+				text << r(i.a);
+				break;
+			case HERA_SAVEF:
+				text << r(i.d);
+				break;
+			case HERA_BZ:
+			case HERA_BNZ:
+			case HERA_BS:
+			case HERA_BL:
+			case HERA_BGE:
+			case HERA_BLE:
+			case HERA_BG:
+			case HERA_BR:
+			case HERA_LABEL:
+				text << ContextInfo::labelName(i.value);
+				break;
+			case HERA_CALL:
+				text << r(i.a) << ',' << functions[i.value];
+				break;
+			default:
+				throw "HERACode::render given an instruction with an unknown opcode";
+		}
+		text << ")\n";
+	}
+}
+
+std::string HERACode::text() const
+{
+	CodeBuffer text;
+	render(text);
+	return text.take();
+}
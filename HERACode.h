@@ -0,0 +1,86 @@
+#ifndef HERA_CODE_H_
+#define HERA_CODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CodeBuffer.h"
+
+/*
+ *  HERACode is the code generated for a program, as a list of HERAInstruction records
+ *    (rather than as text), so that later passes can look at it and improve it
+ *    without having to pick text apart; "render" then writes it out as HERA text.
+ *
+ *  Each instruction has an opcode, up to three register numbers, and one other value,
+ *    which is a constant, an offset from the FP, a label (as a number; see ContextInfo::labelName),
+ *    or a function (the index of its name, see "function"), depending on the opcode:
+ *	CBON()
+ *	SET(d, value)          LOAD(d, value, a)      STORE(d, value, a)
+ *	ADD(d, a, b)           SUB(d, a, b)           MUL(d, a, b)
+ *	AND(d, a, b)           OR(d, a, b)            XOR(d, a, b)           LSR(d, a)
+ *	CMP(a, b)              MOVE(d, a)             FLAGS(a)               SAVEF(d)
+ *	BZ(value)              BNZ(value)             BS(value)              BR(value)
+ *	BL(value)              BGE(value)             BLE(value)             BG(value)
+ *	LABEL(value)           CALL(a, value)
+ *  (BL, BGE, BLE, and BG compare signed numbers, after a CMP, using the overflow flag as well as the sign;
+ *  SAVEF copies the flags into a register: sign in bit 0, zero in bit 1, overflow in bit 2, and so on.)
+ */
+
+// These are used as indices into tables, so keep them in the same order as the tables in HERACode.cc
+enum HERAOpcode : unsigned char {
+	HERA_CBON, HERA_SET, HERA_LOAD, HERA_STORE,
+	HERA_ADD, HERA_SUB, HERA_MUL, HERA_AND, HERA_OR, HERA_XOR, HERA_LSR,
+	HERA_CMP, HERA_MOVE, HERA_FLAGS, HERA_SAVEF,
+	HERA_BZ, HERA_BNZ, HERA_BS, HERA_BL, HERA_BGE, HERA_BLE, HERA_BG, HERA_BR,
+	HERA_LABEL, HERA_CALL,
+	NUMBER_OF_HERA_OPCODES  // not an opcode; keep this last
+};
+const char *opcodeName(HERAOpcode opcode);  // e.g. "SET" for HERA_SET
+
+// The registers with special jobs (the rest are just written R1 etc.)
+enum HERARegister : std::uint8_t { FP_ALT = 12, FP = 14, SP = 15 };
+
+struct HERAInstruction {
+	HERAOpcode opcode;
+	std::uint8_t d, a, b;  // register numbers (d is the one the result goes in, for those that have one)
+	std::int32_t value;
+};
+static_assert(sizeof(HERAInstruction) == 8, "a HERAInstruction is 8 bytes, so lots of them fit in the cache");
+
+class HERACode {
+public:
+	// add an instruction to the end
+	void add(HERAOpcode opcode, int d, int a, int b, int value) { instructions.push_back({ opcode, std::uint8_t(d), std::uint8_t(a), std::uint8_t(b), value }); }
+	void cbon()                            { add(HERA_CBON, 0, 0, 0, 0); }
+	void set(int d, int value)             { add(HERA_SET, d, 0, 0, value); }
+	void load(int d, int offset, int a)    { add(HERA_LOAD, d, a, 0, offset); }
+	void store(int d, int offset, int a)   { add(HERA_STORE, d, a, 0, offset); }
+	void arithmetic(HERAOpcode opcode, int d, int a, int b) { add(opcode, d, a, b, 0); }  // ADD, SUB, MUL, AND, OR, or XOR
+	void lsr(int d, int a)                 { add(HERA_LSR, d, a, 0, 0); }
+	void cmp(int a, int b)                 { add(HERA_CMP, 0, a, b, 0); }
+	void move(int d, int a)                { add(HERA_MOVE, d, a, 0, 0); }
+	void flags(int a)                      { add(HERA_FLAGS, 0, a, 0, 0); }
+	void savef(int d)                      { add(HERA_SAVEF, d, 0, 0, 0); }
+	void branch(HERAOpcode opcode, int label) { add(opcode, 0, 0, 0, label); }  // BZ, BR, etc.
+	void label(int label)                  { add(HERA_LABEL, 0, 0, 0, label); }
+	void call(int a, const std::string &functionName) { add(HERA_CALL, 0, a, 0, function(functionName)); }
+	void append(const HERACode &other);    // add all of "other"'s instructions
+
+	std::size_t size() const { return instructions.size(); }
+	const HERAInstruction &operator[](std::size_t i) const { return instructions[i]; }
+	HERAInstruction &operator[](std::size_t i) { return instructions[i]; }
+	std::vector<HERAInstruction> &all() { return instructions; }  // for passes that add or remove instructions
+
+	int function(const std::string &name);  // the index of a function's name, adding it if it's new
+	const std::string &functionName(int function) const { return functions[function]; }
+
+	// write the code as HERA text, one instruction per line, to the end of "text"
+	void render(CodeBuffer &text) const;
+	std::string text() const;
+private:
+	std::vector<HERAInstruction> instructions;
+	std::vector<std::string> functions;  // e.g. "getint"
+};
+
+#endif /*HERA_CODE_H_*/
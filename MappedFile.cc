@@ -0,0 +1,47 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MappedFile.h"
+
+// To get the two NULs after the text without copying it, we first reserve
+//   enough zero-filled anonymous memory for the text plus the NULs,
+//   and then map the file over the start of that reservation.
+// (Mapping the file alone isn't enough: if the file is an exact multiple of the page size,
+//   the bytes after it aren't part of any mapping at all.)
+MappedFile::MappedFile(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return;
+	}
+	length = info.st_size;
+
+	std::size_t page = sysconf(_SC_PAGESIZE);
+	reserved = (length + 2 + page - 1) / page * page;
+
+	void *region = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	if (length > 0 &&
+	    mmap(region, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(region, reserved);
+		close(fd);
+		return;
+	}
+	close(fd);  // the mapping stays valid after the descriptor is closed
+
+	madvise(region, reserved, MADV_SEQUENTIAL);  // the scanner reads it front to back, once
+	base = static_cast<char *>(region);
+}
+
+MappedFile::~MappedFile()
+{
+	if (base) munmap(base, reserved);
+}
@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string_view>
+
+/*
+ *  A MappedFile makes the contents of a source file available in memory via mmap,
+ *    so that the scanner can hand out std::string_view slices of the file
+ *    rather than copying each token into a std::string.
+ *
+ *  The mapping is followed by two NUL bytes, which is what flex's yy_scan_buffer
+ *    requires at the end of a buffer it scans in place.
+ *  The mapping is private (copy-on-write): flex briefly writes a NUL after each token
+ *    while it is being matched, but those writes never reach the file itself.
+ */
+
+class MappedFile {
+public:
+	MappedFile(const char *path);  // map the named file; check "ok()" to see if that worked
+	~MappedFile();
+
+	bool ok() const { return base != nullptr; }
+
+	std::string_view text() const { return std::string_view(base, length); }
+	char *data() { return base; }           // "length" bytes of text followed by two NULs
+	std::size_t size() const { return length; }
+
+	// C++ Usage Note: "= delete" prevents copying, since two copies would both unmap the same memory
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+private:
+	char *base = nullptr;
+	std::size_t length = 0;
+	std::size_t reserved = 0;  // length rounded up to whole pages, including room for the NULs
+};
+
+#endif /*MAPPED_FILE_H_*/
@@ -0,0 +1,171 @@
+#include <cstring>
+#include <iostream>
+#include "NodeFactory.h"
+#include "streams.h"
+
+using std::endl;
+
+static const std::size_t FIRST_TABLE_SIZE = 64;
+
+NodeFactory::NodeFactory(Arena &nodes) : nodes(nodes)
+{
+}
+
+NodeFactory::~NodeFactory()
+{
+	if (asked > 0) {
+		alloc_trace << "NodeFactory: " << asked << " nodes asked for, " << shared << " of them shared" << endl;
+	}
+}
+
+template <typename Same, typename Make>
+ExprNode *NodeFactory::findOrMake(std::uint32_t hash, Same same, Make make)
+{
+	asked++;
+	if (2 * (entries + 1) > tableSize) grow();  // keep the table at most half full
+
+	std::size_t mask = tableSize - 1;
+	std::size_t slot = hash & mask;
+	for (; table[slot]; slot = (slot + 1) & mask) {
+		if (table[slot]->hash() == hash && same(table[slot])) {
+			shared++;
+			return table[slot];
+		}
+	}
+	table[slot] = make();
+	entries++;
+	return table[slot];
+}
+
+// double the size of the table (the old one stays in the Arena, unused, until it's released)
+void NodeFactory::grow()
+{
+	std::size_t newSize = tableSize ? 2 * tableSize : FIRST_TABLE_SIZE;
+	ExprNode **newTable = static_cast<ExprNode **>(nodes.allocate(newSize * sizeof(ExprNode *), alignof(ExprNode *)));
+	std::memset(newTable, 0, newSize * sizeof(ExprNode *));
+
+	std::size_t mask = newSize - 1;
+	for (std::size_t i = 0; i < tableSize; i++) {
+		if (table[i]) {
+			std::size_t slot = table[i]->hash() & mask;
+			while (newTable[slot]) slot = (slot + 1) & mask;
+			newTable[slot] = table[i];
+		}
+	}
+	table = newTable;
+	tableSize = newSize;
+}
+
+static bool sameChildren(const ChildList &a, const ChildList &b)
+{
+	if (a.size() != b.size()) return false;
+	for (std::size_t i = 0; i < a.size(); i++) {
+		if (!(a[i] == b[i])) return false;
+	}
+	return true;
+}
+
+// C++ Usage Note: "[&]" lets each lambda use the parameters of the method it's in
+//   (and the "static_cast"s are safe, since "same" is only called for nodes with the same hash and kind)
+
+ExprNode *NodeFactory::comparison(Operator op, ExprHandle lhs, ExprHandle rhs)
+{
+	return findOrMake(ComparisonNode::hashOf(op, lhs, rhs),
+		[&](ExprNode *node) {
+			if (node->kind() != COMPARISON_NODE) return false;
+			ComparisonNode *it = static_cast<ComparisonNode *>(node);
+			return it->getOperator() == op && it->getLeft() == lhs && it->getRight() == rhs;
+		},
+		[&]() { return nodes.make<ComparisonNode>(op, lhs, rhs); });
+}
+
+ExprNode *NodeFactory::arithmetic(Operator op, const ChildList &operands)
+{
+	return findOrMake(ArithmeticNode::hashOf(op, operands),
+		[&](ExprNode *node) {
+			if (node->kind() != ARITHMETIC_NODE) return false;
+			ArithmeticNode *it = static_cast<ArithmeticNode *>(node);
+			return it->getOperator() == op && sameChildren(it->getOperands(), operands);
+		},
+		[&]() { return nodes.make<ArithmeticNode>(op, operands); });
+}
+
+ExprNode *NodeFactory::call(const std::string &funcName, const ChildList &arguments)
+{
+	return findOrMake(CallNode::hashOf(funcName, arguments),
+		[&](ExprNode *node) {
+			if (node->kind() != CALL_NODE) return false;
+			CallNode *it = static_cast<CallNode *>(node);
+			return it->getName() == funcName && sameChildren(it->getArguments(), arguments);
+		},
+		[&]() { return nodes.make<CallNode>(funcName, arguments); });
+}
+
+ExprNode *NodeFactory::ifExpression(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse)
+{
+	return findOrMake(IfNode::hashOf(condition, expriftrue, expriffalse),
+		[&](ExprNode *node) {
+			if (node->kind() != IF_NODE) return false;
+			IfNode *it = static_cast<IfNode *>(node);
+			return it->getCondition() == condition && it->getIfTrue() == expriftrue && it->getIfFalse() == expriffalse;
+		},
+		[&]() { return nodes.make<IfNode>(condition, expriftrue, expriffalse); });
+}
+
+ExprNode *NodeFactory::let(ExprHandle declarations, const ChildList &expressions)
+{
+	return findOrMake(LetNode::hashOf(declarations, expressions),
+		[&](ExprNode *node) {
+			if (node->kind() != LET_NODE) return false;
+			LetNode *it = static_cast<LetNode *>(node);
+			return it->getDeclarations() == declarations && sameChildren(it->getExpressions(), expressions);
+		},
+		[&]() { return nodes.make<LetNode>(declarations, expressions); });
+}
+
+ExprNode *NodeFactory::declarations(const ChildList &declarations)
+{
+	return findOrMake(DeclarationsNode::hashOf(declarations),
+		[&](ExprNode *node) {
+			if (node->kind() != DECLARATIONS_NODE) return false;
+			return sameChildren(static_cast<DeclarationsNode *>(node)->getDeclarations(), declarations);
+		},
+		[&]() { return nodes.make<DeclarationsNode>(declarations); });
+}
+
+ExprNode *NodeFactory::declaration(SymbolID variable, ExprHandle value)
+{
+	return findOrMake(DeclarationNode::hashOf(variable, value),
+		[&](ExprNode *node) {
+			if (node->kind() != DECLARATION_NODE) return false;
+			DeclarationNode *it = static_cast<DeclarationNode *>(node);
+			return it->getVariable() == variable && it->getValue() == value;
+		},
+		[&]() { return nodes.make<DeclarationNode>(variable, value); });
+}
+
+ExprHandle NodeFactory::withChildren(ExprHandle original, const ChildList &children)
+{
+	ChildList old = childrenOf(original);
+	if (sameChildren(old, children)) return original;
+	if (old.size() != children.size()) throw "NodeFactory::withChildren given the wrong number of children";
+
+	switch (original.kind()) {
+		case COMPARISON_NODE:
+			return comparison(static_cast<ComparisonNode *>(original.node())->getOperator(), children[0], children[1]);
+		case ARITHMETIC_NODE:
+			return arithmetic(static_cast<ArithmeticNode *>(original.node())->getOperator(), children);
+		case CALL_NODE:
+			return call(static_cast<CallNode *>(original.node())->getName(), children);
+		case IF_NODE:
+			return ifExpression(children[0], children[1], children[2]);
+		case LET_NODE:
+			return let(children[0], ChildList(children.begin() + 1, children.end()));
+		case DECLARATIONS_NODE:
+			return declarations(children);
+		case DECLARATION_NODE:
+			return declaration(static_cast<DeclarationNode *>(original.node())->getVariable(), children[0]);
+		default:
+			throw "NodeFactory::withChildren given a node of unknown kind";
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef NODE_FACTORY_H_
+#define NODE_FACTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "AST.h"
+#include "Arena.h"
+#include "ExprVisitor.h"
+
+/*
+ *  A NodeFactory makes AST nodes in an Arena, but "hash-conses" them:
+ *    if a node just like the one asked for (the same kind, data, and children) has already been made,
+ *    it gives back that one, rather than making another.
+ *  Since children are always made first, equal subtrees are then always the very same node,
+ *    so checking whether two children are equal is just comparing their ExprHandles,
+ *    and a program with lots of repetition (e.g. one that was generated by another program)
+ *    takes only as much memory as its distinct subtrees.
+ *
+ *  This is safe because nodes never change once they're made (see AST.h),
+ *    and since each node's StructuralHash is cached in it, a later pass can also use the hash
+ *    (with the node itself, since equal nodes are identical) to remember a result for each distinct subtree.
+ *
+ *  The NodeFactory's table is in the Arena too, so it goes away along with the nodes;
+ *    a NodeFactory mustn't be used after its Arena is released.
+ */
+
+class NodeFactory {
+public:
+	NodeFactory(Arena &nodes);
+	~NodeFactory();  // writes to alloc_trace how many nodes were shared
+
+	ExprNode *comparison(Operator op, ExprHandle lhs, ExprHandle rhs);
+	ExprNode *arithmetic(Operator op, const ChildList &operands);
+	ExprNode *call(const std::string &funcName, const ChildList &arguments);
+	ExprNode *ifExpression(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse);
+	ExprNode *let(ExprHandle declarations, const ChildList &expressions);
+	ExprNode *declarations(const ChildList &declarations);
+	ExprNode *declaration(SymbolID variable, ExprHandle value);
+
+	// a node like "original" but with these children (in the order forEachChild gives them; see ExprVisitor.h),
+	//   or "original" itself if they're the children it already has, so a pass that changes part of a tree
+	//   only makes new nodes on the way up from the change, and everything else stays just as it was
+	ExprHandle withChildren(ExprHandle original, const ChildList &children);
+
+	unsigned long nodesAskedFor() const { return asked; }
+	unsigned long nodesShared() const { return shared; }  // i.e. asked for but not made
+
+	// C++ Usage Note: see Arena.h
+	NodeFactory(const NodeFactory &) = delete;
+	NodeFactory &operator=(const NodeFactory &) = delete;
+private:
+	// the node in the table with this hash for which "same" is true, or else the one "make" makes;
+	//   "same" and "make" are lambdas (see NodeFactory.cc)
+	template <typename Same, typename Make>
+	ExprNode *findOrMake(std::uint32_t hash, Same same, Make make);
+	void grow();
+
+	Arena &nodes;
+	ExprNode **table = nullptr;  // open addressing, with linear probing; nullptr for an empty slot
+	std::size_t tableSize = 0;   // always a power of 2
+	std::size_t entries = 0;
+	unsigned long asked = 0;
+	unsigned long shared = 0;
+};
+
+#endif /*NODE_FACTORY_H_*/
@@ -0,0 +1,84 @@
+#include <chrono>
+#include <iostream>
+#include "PassManager.h"
+#include "streams.h"
+
+using std::endl;
+
+NodeSet nodesIn(ExprHandle root)
+{
+	NodeSet found;
+	std::vector<ExprHandle> toDo;
+	if (!root.isNull() && !root.isImmediate()) toDo.push_back(root);
+	while (!toDo.empty()) {
+		ExprHandle e = toDo.back();
+		toDo.pop_back();
+		if (found.insert(e.node()).second) {  // (i.e. we hadn't seen it before)
+			forEachChild(e, [&](ExprHandle child) { if (!child.isImmediate()) toDo.push_back(child); });
+		}
+	}
+	return found;
+}
+
+// like Analysis::resultFor, children first with a stack of our own;
+//   "rewritten" has the new version of each node that's been done, so shared ones are only done once
+ExprHandle RewritePass::run(ExprHandle root, NodeFactory &nodes)
+{
+	if (root.isNull()) return root;
+	if (root.isImmediate()) return rewrite(root, nodes);
+
+	std::unordered_map<const ExprNode *, ExprHandle> rewritten;
+	std::vector<std::pair<ExprHandle, bool>> stack;
+	stack.emplace_back(root, false);
+	while (!stack.empty()) {
+		ExprHandle node = stack.back().first;
+		if (rewritten.count(node.node())) {
+			stack.pop_back();
+		} else if (stack.back().second) {
+			stack.pop_back();
+			ChildList children;
+			forEachChild(node, [&](ExprHandle child) {
+				children.push_back(child.isImmediate() ? rewrite(child, nodes) : rewritten.find(child.node())->second);
+			});
+			rewritten.emplace(node.node(), rewrite(nodes.withChildren(node, children), nodes));
+		} else {
+			stack.back().second = true;
+			forEachChild(node, [&](ExprHandle child) {
+				if (!child.isImmediate() && !rewritten.count(child.node())) stack.emplace_back(child, false);
+			});
+		}
+	}
+	return rewritten.find(root.node())->second;
+}
+
+void PassManager::add(AnalysisPass &pass)
+{
+	passes.push_back(&pass);
+	analyses.push_back(&pass);
+}
+
+void PassManager::add(Pass &pass)
+{
+	passes.push_back(&pass);
+}
+
+ExprHandle PassManager::run(ExprHandle root)
+{
+	using clock = std::chrono::steady_clock;
+	for (Pass *pass : passes) {
+		auto start = clock::now();
+		ExprHandle result = pass->run(root, nodes);
+		bool changed = !(result == root);
+		if (changed) {
+			// only the nodes that aren't in the new tree have changed, so those are the only results to forget
+			NodeSet stillThere = nodesIn(result);
+			for (AnalysisPass *analysis : analyses) {
+				analysis->forgetAllBut(stillThere);
+			}
+			root = result;
+		}
+		std::chrono::duration<double> time = clock::now() - start;
+		trace << "Pass " << pass->name() << ": " << time.count() << " s" << (changed ? ", changed the tree" : "") << endl;
+	}
+	return root;
+}
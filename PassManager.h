@@ -0,0 +1,150 @@
+#ifndef PASS_MANAGER_H_
+#define PASS_MANAGER_H_
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "AST.h"
+#include "ExprVisitor.h"
+#include "NodeFactory.h"
+
+/*
+ *  A PassManager runs a list of passes over a program's tree, in order, between parsing and code generation:
+ *    an AnalysisPass works out something about each node (e.g. its type) and remembers it,
+ *    and a TransformPass gives back a new tree (e.g. with constant expressions worked out).
+ *
+ *  Since nodes never change (see AST.h), a transform doesn't change the tree it's given;
+ *    it makes new nodes with a NodeFactory, for the parts it changes and the nodes above them,
+ *    and the new tree shares every subtree it didn't touch with the old one (see NodeFactory::withChildren).
+ *  So an analysis remembers its results by node: a result is still right for a node in the new tree
+ *    (which is the same node, with the same subtree), and a node that was replaced is simply
+ *    a different node, with no result yet.  After a transform, the PassManager has each analysis
+ *    forget the results for nodes that aren't in the new tree any more, and nothing else,
+ *    so later passes (and code generation) get the rest without working them out again.
+ *
+ *  For this to be right, an analysis's result for a node must depend only on the node's subtree,
+ *    since one node can be in several places in a tree (see NodeFactory.h);
+ *    something that depends on where the node is (e.g. which declaration a variable refers to)
+ *    has to be left for whoever knows that (e.g. code generation) to finish off.
+ */
+
+typedef std::unordered_set<const ExprNode *> NodeSet;
+
+// the nodes in the tree "root" (not counting immediates), each once
+NodeSet nodesIn(ExprHandle root);
+
+class Pass {
+public:
+	Pass(const char *name) : passName(name) { }
+	virtual ~Pass() = default;
+	const char *name() const { return passName; }
+
+	// do this pass to the tree "root", giving back the tree that later passes should use
+	//   (an AnalysisPass gives back "root" itself)
+	virtual ExprHandle run(ExprHandle root, NodeFactory &nodes) = 0;
+private:
+	const char *passName;
+};
+
+class AnalysisPass : public Pass {
+public:
+	AnalysisPass(const char *name) : Pass(name) { }
+	virtual void forgetAllBut(const NodeSet &keep) = 0;  // forget the results for nodes not in "keep"
+	virtual std::size_t resultsKept() const = 0;
+};
+
+// An Analysis<Result> works out a Result for a node with its ExprVisitor methods,
+//   which can use "resultFor" to get the results for the node's children (which are worked out first);
+//   immediates get a result too, but since they aren't nodes, theirs aren't remembered.
+template <typename Result>
+class Analysis : public AnalysisPass, protected ExprVisitor<Result> {
+public:
+	Analysis(const char *name) : AnalysisPass(name) { }
+
+	// the result for "e", working it out (and those for the parts of its subtree that need it) if need be
+	Result resultFor(ExprHandle e);
+
+	ExprHandle run(ExprHandle root, NodeFactory &) { resultFor(root); return root; }
+	void forgetAllBut(const NodeSet &keep);
+	std::size_t resultsKept() const { return results.size(); }
+	unsigned long resultsWorkedOut() const { return workedOut; }
+private:
+	std::unordered_map<const ExprNode *, Result> results;
+	unsigned long workedOut = 0;
+};
+
+// A RewritePass makes a new tree from the bottom up: "rewrite" is called for each node,
+//   given the node with its children already rewritten, and gives back what should replace it
+//   (which may be that very node, if it doesn't need changing).
+// A subtree that's in the tree several times is only rewritten once.
+class RewritePass : public Pass {
+public:
+	RewritePass(const char *name) : Pass(name) { }
+	ExprHandle run(ExprHandle root, NodeFactory &nodes);
+protected:
+	virtual ExprHandle rewrite(ExprHandle e, NodeFactory &nodes) = 0;
+};
+
+class PassManager {
+public:
+	PassManager(NodeFactory &nodes) : nodes(nodes) { }
+
+	// add a pass to the end of the list (the PassManager doesn't own it, and it must last until "run" is done)
+	void add(AnalysisPass &pass);
+	void add(Pass &pass);  // a transform
+
+	// run all the passes, in the order they were added, giving back the final tree;
+	//   writes to trace how long each one took
+	ExprHandle run(ExprHandle root);
+private:
+	NodeFactory &nodes;
+	std::vector<Pass *> passes;
+	std::vector<AnalysisPass *> analyses;  // the passes that remember results
+};
+
+
+// The template methods (see ExprVisitor.h for why they're here)
+
+// This works out the results for a subtree's nodes children first, with a stack of its own,
+//   rather than by calling itself, so a very deep tree can't overflow the call stack;
+//   by the time a node is visited, resultFor its children just looks up what's already there.
+template <typename Result>
+Result Analysis<Result>::resultFor(ExprHandle e)
+{
+	if (e.isImmediate()) return this->visit(e);
+	auto found = results.find(e.node());
+	if (found != results.end()) return found->second;
+
+	std::vector<std::pair<ExprHandle, bool>> stack;  // each node, and whether its children have been pushed yet
+	stack.emplace_back(e, false);
+	while (!stack.empty()) {
+		ExprHandle node = stack.back().first;
+		if (results.count(node.node())) {  // (it was in the subtree more than once)
+			stack.pop_back();
+		} else if (stack.back().second) {
+			stack.pop_back();
+			Result result = this->visit(node);
+			results.emplace(node.node(), result);
+			workedOut++;
+		} else {
+			stack.back().second = true;
+			forEachChild(node, [&](ExprHandle child) {
+				if (!child.isImmediate() && !results.count(child.node())) stack.emplace_back(child, false);
+			});
+		}
+	}
+	return results.find(e.node())->second;
+}
+
+template <typename Result>
+void Analysis<Result>::forgetAllBut(const NodeSet &keep)
+{
+	for (auto i = results.begin(); i != results.end(); ) {
+		i = keep.count(i->first) ? std::next(i) : results.erase(i);
+	}
+}
+
+#endif /*PASS_MANAGER_H_*/
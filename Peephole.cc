@@ -0,0 +1,328 @@
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Peephole.h"
+
+using std::vector;
+
+// A set of registers, as a bit for each register number, plus a bit for the flags
+typedef std::uint32_t RegisterSet;
+static const RegisterSet FLAGS_SET = 1u << 16;
+static const RegisterSet ALL_REGISTERS = 0xfffe;  // R1 to R15 (R0 is always 0)
+
+static RegisterSet reg(int r)
+{
+	return r == 0 ? 0 : 1u << r;
+}
+
+// the registers we're free to change the uses of (i.e. not FP_alt, PC_ret, FP, or SP)
+static bool ordinary(int r)
+{
+	return r >= 1 && r <= 11;
+}
+
+static bool isBranch(HERAOpcode opcode)
+{
+	switch (opcode) {
+		case HERA_BZ:
+		case HERA_BNZ:
+		case HERA_BS:
+		case HERA_BL:
+		case HERA_BGE:
+		case HERA_BLE:
+		case HERA_BG:
+		case HERA_BR:
+			return true;
+		default:
+			return false;
+	}
+}
+
+namespace {
+struct Effects {
+	RegisterSet uses = 0;
+	RegisterSet defs = 0;
+	bool keep = false;  // it does more than set registers and flags (or is a branch or label), so don't remove it as dead
+};
+}
+
+// what an instruction reads and writes (arithmetic, MOVE, and LOAD set the flags, as CMP and FLAGS do)
+static Effects effects(const HERAInstruction &i)
+{
+	Effects e;
+	switch (i.opcode) {
+		case HERA_SET:   e.defs = reg(i.d); break;
+		case HERA_LOAD:  e.uses = reg(i.a); e.defs = reg(i.d) | FLAGS_SET; break;
+		case HERA_STORE: e.uses = reg(i.d) | reg(i.a); e.keep = true; break;
+		case HERA_ADD:
+		case HERA_SUB:
+		case HERA_MUL:
+		case HERA_AND:
+		case HERA_OR:
+		case HERA_XOR:   e.uses = reg(i.a) | reg(i.b); e.defs = reg(i.d) | FLAGS_SET; break;
+		case HERA_LSR:   e.uses = reg(i.a); e.defs = reg(i.d) | FLAGS_SET; break;
+		case HERA_CMP:   e.uses = reg(i.a) | reg(i.b); e.defs = FLAGS_SET; break;
+		case HERA_MOVE:  e.uses = reg(i.a); e.defs = (i.d == i.a ? 0 : reg(i.d)) | FLAGS_SET; break;
+		case HERA_FLAGS: e.uses = reg(i.a); e.defs = FLAGS_SET; break;
+		case HERA_SAVEF: e.uses = FLAGS_SET; e.defs = reg(i.d); break;
+		case HERA_BZ:
+		case HERA_BNZ:
+		case HERA_BS:
+		case HERA_BL:
+		case HERA_BGE:
+		case HERA_BLE:
+		case HERA_BG:    e.uses = FLAGS_SET; e.keep = true; break;
+		case HERA_CALL:  // (which swaps the FP with its register, and leaves the function's result in R1)
+			e.uses = reg(i.a) | reg(FP) | reg(SP);
+			e.defs = reg(i.a) | reg(FP) | reg(13) | reg(1) | FLAGS_SET;
+			e.keep = true;
+			break;
+		default:         e.keep = true; break;  // CBON, BR, LABEL
+	}
+	return e;
+}
+
+// have an instruction read register "to" wherever it read "from"
+static void replaceReads(HERAInstruction &i, int from, int to)
+{
+	switch (i.opcode) {
+		case HERA_ADD:
+		case HERA_SUB:
+		case HERA_MUL:
+		case HERA_AND:
+		case HERA_OR:
+		case HERA_XOR:
+		case HERA_CMP:
+			if (i.b == from) i.b = to;
+			[[fallthrough]];  // and a:
+		case HERA_LSR:
+		case HERA_MOVE:
+		case HERA_FLAGS:
+		case HERA_LOAD:
+			if (i.a == from) i.a = to;
+			break;
+		case HERA_STORE:
+			if (i.d == from) i.d = to;
+			if (i.a == from) i.a = to;
+			break;
+		default:
+			break;
+	}
+}
+
+// which registers (and flags) are live right after each instruction, i.e. may be read before they're set again;
+//   only "result" is live at the end of the program
+static vector<RegisterSet> liveAfter(const vector<HERAInstruction> &code, int result)
+{
+	std::size_t n = code.size();
+	vector<RegisterSet> before(n + 1, 0), after(n, 0);
+	before[n] = reg(result);
+	std::unordered_map<int, RegisterSet> atLabel;  // (labels can be repeated, so this is what's live at any of them)
+	for (const HERAInstruction &i : code) {
+		if (i.opcode == HERA_LABEL) atLabel[i.value] = 0;
+	}
+
+	bool changed = true;
+	while (changed) {  // (only more than once if something branches backward)
+		changed = false;
+		for (std::size_t i = n; i-- > 0; ) {
+			const HERAInstruction &in = code[i];
+			RegisterSet out = in.opcode == HERA_BR ? 0 : before[i + 1];
+			if (isBranch(in.opcode)) {
+				auto target = atLabel.find(in.value);
+				out |= target == atLabel.end() ? ALL_REGISTERS : target->second;
+			}
+			Effects e = effects(in);
+			after[i] = out;
+			RegisterSet live = e.uses | (out & ~e.defs);
+			if (live != before[i]) {
+				before[i] = live;
+				changed = true;
+			}
+			if (in.opcode == HERA_LABEL && (atLabel[in.value] | live) != atLabel[in.value]) {
+				atLabel[in.value] |= live;
+				changed = true;
+			}
+		}
+	}
+	return after;
+}
+
+// take out the instructions marked in "remove", giving back whether there were any
+static bool removeMarked(vector<HERAInstruction> &code, const vector<bool> &remove)
+{
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < code.size(); i++) {
+		if (!remove[i]) code[kept++] = code[i];
+	}
+	bool any = kept != code.size();
+	code.resize(kept);
+	return any;
+}
+
+// the code after a BR, up to the next label, can't be reached
+static bool removeUnreachable(vector<HERAInstruction> &code)
+{
+	vector<bool> remove(code.size(), false);
+	bool reachable = true;
+	for (std::size_t i = 0; i < code.size(); i++) {
+		if (code[i].opcode == HERA_LABEL) {
+			reachable = true;
+		} else if (!reachable) {
+			remove[i] = true;
+		} else if (code[i].opcode == HERA_BR) {
+			reachable = false;
+		}
+	}
+	return removeMarked(code, remove);
+}
+
+// a branch to a label that comes right after it (perhaps along with others) does nothing
+static bool removeBranchesToNext(vector<HERAInstruction> &code)
+{
+	vector<bool> remove(code.size(), false);
+	for (std::size_t i = 0; i < code.size(); i++) {
+		if (isBranch(code[i].opcode)) {
+			for (std::size_t j = i + 1; j < code.size() && code[j].opcode == HERA_LABEL; j++) {
+				if (code[j].value == code[i].value) {
+					remove[i] = true;
+					break;
+				}
+			}
+		}
+	}
+	return removeMarked(code, remove);
+}
+
+static bool removeUnusedLabels(vector<HERAInstruction> &code)
+{
+	std::unordered_set<int> used;
+	for (const HERAInstruction &i : code) {
+		if (isBranch(i.opcode)) used.insert(i.value);
+	}
+	vector<bool> remove(code.size(), false);
+	for (std::size_t i = 0; i < code.size(); i++) {
+		remove[i] = code[i].opcode == HERA_LABEL && !used.count(code[i].value);
+	}
+	return removeMarked(code, remove);
+}
+
+// After MOVE(d, s), have the instructions that read d read s instead, until either changes
+//   (or another path could come in, at a label); the MOVE is then often dead, for removeDead.
+static bool propagateCopies(vector<HERAInstruction> &code)
+{
+	bool changed = false;
+	for (std::size_t i = 0; i < code.size(); i++) {
+		int d = code[i].d, s = code[i].a;
+		if (code[i].opcode != HERA_MOVE || d == s || !ordinary(d) || !ordinary(s)) continue;
+		for (std::size_t j = i + 1; j < code.size(); j++) {
+			HERAInstruction &next = code[j];
+			if (next.opcode == HERA_LABEL || next.opcode == HERA_BR || next.opcode == HERA_CALL) break;
+			Effects e = effects(next);
+			if (e.uses & reg(d)) {
+				replaceReads(next, d, s);
+				changed = true;
+			}
+			if (e.defs & (reg(d) | reg(s))) break;
+		}
+	}
+	return changed;
+}
+
+// For MOVE(d, s), where s was just set (in the same block) and isn't needed after the MOVE,
+//   have the instruction that set s set d instead, and remove the MOVE.
+// Each of these changes what's live only between that instruction and the MOVE,
+//   so one "live" works for several of them, as long as those stretches don't overlap.
+static bool foldMoves(vector<HERAInstruction> &code, int result)
+{
+	vector<RegisterSet> live = liveAfter(code, result);
+	vector<bool> remove(code.size(), false);
+	std::size_t firstFree = 0;  // where the last fold's stretch ended
+	for (std::size_t i = 0; i < code.size(); i++) {
+		int d = code[i].d, s = code[i].a;
+		if (code[i].opcode != HERA_MOVE || d == s || !ordinary(d) || !ordinary(s) || (live[i] & (reg(s) | FLAGS_SET))) continue;
+		for (std::size_t k = i; k-- > firstFree; ) {
+			HERAInstruction &earlier = code[k];
+			if (earlier.opcode == HERA_LABEL || isBranch(earlier.opcode) || earlier.opcode == HERA_CALL) break;
+			Effects e = effects(earlier);
+			if (e.defs & reg(s)) {
+				bool setsD = earlier.opcode != HERA_CMP && earlier.opcode != HERA_FLAGS && earlier.opcode != HERA_STORE;
+				if (setsD && earlier.d == s) {
+					earlier.d = d;
+					remove[i] = true;
+					firstFree = i + 1;
+				}
+				break;
+			}
+			if (((e.uses | e.defs) & reg(d)) || (e.uses & reg(s))) break;
+		}
+	}
+	return removeMarked(code, remove);
+}
+
+// After STORE(r, offset, a), a LOAD from the same place (before anything could change r, a, or that place)
+//   gets what's already in r: it can go if it would load r itself (and nothing tests the flags it sets),
+//   or become a MOVE from r otherwise (which sets the same flags), for propagateCopies to work on.
+static bool forwardStores(vector<HERAInstruction> &code, int result)
+{
+	vector<RegisterSet> live = liveAfter(code, result);
+	vector<bool> remove(code.size(), false);
+	bool changed = false;
+	for (std::size_t i = 0; i < code.size(); i++) {
+		const HERAInstruction store = code[i];
+		if (store.opcode != HERA_STORE) continue;
+		for (std::size_t j = i + 1; j < code.size(); j++) {
+			HERAInstruction &next = code[j];
+			if (next.opcode == HERA_LABEL || isBranch(next.opcode) || next.opcode == HERA_CALL) break;
+			if (next.opcode == HERA_LOAD && next.a == store.a && next.value == store.value) {
+				if (next.d == store.d) {
+					if (live[j] & FLAGS_SET) break;
+					remove[j] = true;
+				} else {
+					next = { HERA_MOVE, next.d, store.d, 0, 0 };
+					changed = true;
+				}
+				continue;
+			}
+			// (a STORE elsewhere in the same frame leaves this place alone)
+			bool otherPlace = next.opcode == HERA_STORE && next.a == store.a && next.value != store.value;
+			if (next.opcode == HERA_STORE && !otherPlace) break;
+			if (effects(next).defs & (reg(store.d) | reg(store.a))) break;
+		}
+	}
+	return removeMarked(code, remove) || changed;
+}
+
+// remove the instructions that only set registers (or flags) that aren't used before they're set again
+static bool removeDead(vector<HERAInstruction> &code, int result)
+{
+	vector<RegisterSet> live = liveAfter(code, result);
+	vector<bool> remove(code.size(), false);
+	for (std::size_t i = 0; i < code.size(); i++) {
+		Effects e = effects(code[i]);
+		remove[i] = !e.keep && (e.defs & live[i]) == 0;
+	}
+	return removeMarked(code, remove);
+}
+
+std::size_t peephole(HERACode &code, int resultRegister)
+{
+	vector<HERAInstruction> &instructions = code.all();
+	std::size_t before = instructions.size();
+	bool changed = true;
+	while (changed) {
+		// C++ Usage Note: one statement per pass, since each works on what the one before left,
+		//   and the operands of a single "a | b | ..." could be evaluated in any order;
+		//   "|=" (unlike "||") still does every pass each time around
+		changed = false;
+		changed |= removeUnreachable(instructions);
+		changed |= removeBranchesToNext(instructions);
+		changed |= removeUnusedLabels(instructions);
+		changed |= forwardStores(instructions, resultRegister);
+		changed |= propagateCopies(instructions);
+		changed |= foldMoves(instructions, resultRegister);
+		changed |= removeDead(instructions, resultRegister);
+	}
+	return before - instructions.size();
+}
@@ -0,0 +1,27 @@
+#ifndef PEEPHOLE_H_
+#define PEEPHOLE_H_
+
+#include <cstddef>
+#include "HERACode.h"
+
+/*
+ *  The peephole optimizer tidies up the HERACode that code generation makes, a few instructions at a time:
+ *    it removes branches to the very next instruction, code right after a BR that can't be reached,
+ *    labels that nothing branches to, instructions whose results are never used (e.g. a SET
+ *    of a register that's set again before it's read), and LOADs of what was just stored from
+ *    that same register; it has later instructions read a MOVE's source rather than its copy,
+ *    where it can (e.g. the MOVE after each CALL), and it has an instruction put its result
+ *    right where a MOVE right after it would have copied it (e.g. SET then MOVE).
+ *  It keeps doing that until there's nothing more to do, since each change can make room for another.
+ *
+ *  Only the register holding the program's result needs its value at the end of the program
+ *    (other registers keep theirs only while later instructions read them, as do the flags
+ *    while a later branch tests them); CALL, STORE, and CBON are kept no matter what,
+ *    since they do more than set registers.
+ */
+
+// improve "code" in place, for a program that leaves its result in "resultRegister",
+//   giving back the number of instructions it removed
+std::size_t peephole(HERACode &code, int resultRegister);
+
+#endif /*PEEPHOLE_H_*/
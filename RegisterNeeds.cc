@@ -0,0 +1,110 @@
+#include <algorithm>
+#include "RegisterNeeds.h"
+
+// whether doing the right-hand operand first takes fewer registers
+static bool rightFirstIsBetter(RegisterNeed left, RegisterNeed right)
+{
+	return right.registers > left.registers && !(left.calls && right.calls);
+}
+
+bool evaluateRightFirst(RegisterNeed left, RegisterNeed right, int registers)
+{
+	return rightFirstIsBetter(left, right) && right.registers + 1 > registers;  // (left to right takes one more than "right")
+}
+
+RegisterNeed operandsNeed(RegisterNeed left, RegisterNeed right)
+{
+	RegisterNeed first = left, second = right;
+	if (rightFirstIsBetter(left, right)) std::swap(first, second);
+	return { std::max(first.registers, second.registers + 1), left.calls || right.calls };
+}
+
+RegisterNeed eitherNeed(RegisterNeed first, RegisterNeed second)
+{
+	return { std::max(first.registers, second.registers), first.calls || second.calls };
+}
+
+RegisterNeed letExpressionNeed(RegisterNeed expression, std::size_t place)
+{
+	return { expression.registers + int(place), expression.calls };
+}
+
+RegisterNeed RegisterNeeds::visitComparison(const ComparisonNode &node)
+{
+	return operandsNeed(resultFor(node.getLeft()), resultFor(node.getRight()));
+}
+
+// (code generation only does arithmetic with two operands, and reports any other)
+RegisterNeed RegisterNeeds::visitArithmetic(const ArithmeticNode &node)
+{
+	const ChildList &operands = node.getOperands();
+	if (operands.size() == 2) return operandsNeed(resultFor(operands[0]), resultFor(operands[1]));
+	RegisterNeed need = { 1, false };
+	for (ExprHandle operand : operands) need = eitherNeed(need, resultFor(operand));
+	return need;
+}
+
+RegisterNeed RegisterNeeds::visitCall(const CallNode &node)
+{
+	RegisterNeed need = { 1, true };
+	for (ExprHandle argument : node.getArguments()) need = eitherNeed(need, resultFor(argument));
+	return need;
+}
+
+RegisterNeed RegisterNeeds::visitIf(const IfNode &node)
+{
+	return eitherNeed(resultFor(node.getCondition()), eitherNeed(resultFor(node.getIfTrue()), resultFor(node.getIfFalse())));
+}
+
+RegisterNeed RegisterNeeds::visitLet(const LetNode &node)
+{
+	RegisterNeed need = resultFor(node.getDeclarations());
+	const ChildList &expressions = node.getExpressions();
+	for (std::size_t i = 0; i < expressions.size(); i++) need = eitherNeed(need, letExpressionNeed(resultFor(expressions[i]), i));
+	return need;
+}
+
+RegisterNeed RegisterNeeds::visitDeclarations(const DeclarationsNode &node)
+{
+	RegisterNeed need = { 1, false };
+	for (ExprHandle declaration : node.getDeclarations()) need = eitherNeed(need, resultFor(declaration));
+	return need;
+}
+
+// Since each entry comes after its children, one pass through the entries, in order, does them all (as in inferTypes)
+std::vector<RegisterNeed> registerNeeds(const FlatAST &program)
+{
+	std::vector<RegisterNeed> needs;
+	needs.reserve(program.size());
+	for (FlatAST::Index i = 0; i < program.size(); i++) {
+		RegisterNeed need = { 1, program.kind(i) == CALL_NODE };
+		if (!program.isLeaf(i)) {
+			FlatAST::IndexList children = program.children(i);
+			switch (program.kind(i)) {
+				case ARITHMETIC_NODE:
+				case COMPARISON_NODE:
+					if (children.size() == 2) {
+						need = operandsNeed(needs[children[0]], needs[children[1]]);
+						break;
+					}
+					for (FlatAST::Index child : children) need = eitherNeed(need, needs[child]);
+					break;
+				case LET_NODE:
+					for (std::size_t c = 0; c < children.size(); c++) {
+						need = eitherNeed(need, c == 0 ? needs[children[c]] : letExpressionNeed(needs[children[c]], c - 1));
+					}
+					break;
+				case CALL_NODE:
+				case IF_NODE:
+				case DECLARATIONS_NODE:
+				case DECLARATION_NODE:
+					for (FlatAST::Index child : children) need = eitherNeed(need, needs[child]);
+					break;
+				default:
+					throw "registerNeeds given an entry of unknown kind";
+			}
+		}
+		needs.push_back(need);
+	}
+	return needs;
+}
@@ -0,0 +1,67 @@
+#ifndef REGISTER_NEEDS_H_
+#define REGISTER_NEEDS_H_
+
+#include <vector>
+#include "AST.h"
+#include "FlatAST.h"
+#include "PassManager.h"
+
+/*
+ *  Register needs (Sethi-Ullman, or Ershov, numbers) say how many registers each expression takes
+ *    to evaluate, so that code generation can do the operands of arithmetic and comparisons in
+ *    whichever order takes fewer of them.
+ *
+ *  An expression's value goes in its context's register, and its code can use that register and
+ *    the ones below it (see ContextInfo.h); the operand done first holds its value in the operator's
+ *    register while the other is done in the registers below that.  So doing the needier operand first
+ *    takes just what it needs, while doing it second takes one more than that.
+ *    E.g. (+ 1 (+ 2 (+ 3 4))) takes four registers from left to right, but only two from right to left.
+ *  The operands stay where they were in the instruction (e.g. SUB or CMP), whichever is done first.
+ *
+ *  Operands are only done right to left when left to right would take more registers than there are,
+ *    though, since the program's own order tends to give the peephole optimizer more to work with
+ *    (e.g. in (+ x (* y z)) inside the let* that declares x, x's value may still be in its register).
+ *
+ *  A call (e.g. to getint) has to happen in its place in the program, so if both operands make calls,
+ *    they're always done from left to right.
+ */
+
+struct RegisterNeed {
+	int registers;  // to evaluate the expression
+	bool calls;     // whether it makes any calls
+};
+
+// the rules for each kind of expression that has children, shared by the tree and FlatAST versions below
+
+// whether to evaluate an operator's right-hand operand before its left-hand one,
+//   with "registers" registers for the operator (its own and the ones below it)
+bool evaluateRightFirst(RegisterNeed left, RegisterNeed right, int registers);
+// the need of an operator with these operands, in the order that takes the fewest registers
+RegisterNeed operandsNeed(RegisterNeed left, RegisterNeed right);
+// the need of two expressions evaluated one after the other, in the same register (e.g. an if's condition and branches)
+RegisterNeed eitherNeed(RegisterNeed first, RegisterNeed second);
+// the need of a let*'s expression, given its place among them (since each one's register is below the one before's)
+RegisterNeed letExpressionNeed(RegisterNeed expression, std::size_t place);
+
+
+// The register need analysis, for trees; after it has run, resultFor gives each node's need
+class RegisterNeeds : public Analysis<RegisterNeed> {
+public:
+	RegisterNeeds() : Analysis<RegisterNeed>("register needs") { }
+protected:
+	RegisterNeed visitInteger(int) { return { 1, false }; }
+	RegisterNeed visitBoolean(bool) { return { 1, false }; }
+	RegisterNeed visitVariable(SymbolID) { return { 1, false }; }
+	RegisterNeed visitComparison(const ComparisonNode &node);
+	RegisterNeed visitArithmetic(const ArithmeticNode &node);
+	RegisterNeed visitCall(const CallNode &node);
+	RegisterNeed visitIf(const IfNode &node);
+	RegisterNeed visitLet(const LetNode &node);
+	RegisterNeed visitDeclarations(const DeclarationsNode &node);
+	RegisterNeed visitDeclaration(const DeclarationNode &node) { return resultFor(node.getValue()); }
+};
+
+// The same, for a FlatAST: the need of each entry, at the same index
+std::vector<RegisterNeed> registerNeeds(const FlatAST &program);
+
+#endif /*REGISTER_NEEDS_H_*/
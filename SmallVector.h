@@ -0,0 +1,89 @@
+#ifndef SMALL_VECTOR_H_
+#define SMALL_VECTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+
+/*
+ *  A SmallVector<T, N> is a sequence of T kept in one contiguous array, like std::vector,
+ *    but with room for the first N elements inside the SmallVector itself,
+ *    so a short sequence (e.g. the two operands of "+") needs no separate allocation at all;
+ *    longer ones (e.g. the expressions of a big let*) move to one growing array on the heap.
+ *
+ *  It's only meant for simple things like the pointers to an AST node's children,
+ *    so T must be trivially copyable (elements are moved around with memcpy).
+ */
+
+template <typename T, std::size_t N>
+class SmallVector {
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially-copyable things");
+	static_assert(N > 0, "a SmallVector needs room for at least one element inside it");
+public:
+	SmallVector() { }
+	SmallVector(const T *first, const T *last)  // a copy of the elements from first up to (not including) last
+	{
+		reserve(last - first);
+		if (first != last) std::memcpy(elements, first, (last - first) * sizeof(T));
+		count = last - first;
+	}
+	SmallVector(std::initializer_list<T> items) : SmallVector(items.begin(), items.end()) { }
+
+	SmallVector(const SmallVector &other) : SmallVector(other.begin(), other.end()) { }
+	SmallVector &operator=(const SmallVector &other)
+	{
+		if (this != &other) {
+			count = 0;
+			reserve(other.count);
+			if (other.count) std::memcpy(elements, other.elements, other.count * sizeof(T));
+			count = other.count;
+		}
+		return *this;
+	}
+	~SmallVector()
+	{
+		if (elements != inlineElements()) std::free(elements);
+	}
+
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T &operator[](std::size_t i) { return elements[i]; }
+	const T &operator[](std::size_t i) const { return elements[i]; }
+
+	// C++ Usage Note: begin and end let us write "for (ExprHandle child : children)"
+	T *begin() { return elements; }
+	T *end() { return elements + count; }
+	const T *begin() const { return elements; }
+	const T *end() const { return elements + count; }
+
+	void push_back(const T &item)
+	{
+		if (count == capacity) reserve(2 * capacity);
+		elements[count++] = item;
+	}
+
+	void reserve(std::size_t wanted)
+	{
+		if (wanted <= capacity) return;
+		T *bigger = static_cast<T *>(std::malloc(wanted * sizeof(T)));
+		if (!bigger) throw std::bad_alloc();
+		std::memcpy(bigger, elements, count * sizeof(T));
+		if (elements != inlineElements()) std::free(elements);
+		elements = bigger;
+		capacity = wanted;
+	}
+private:
+	T *inlineElements() { return reinterpret_cast<T *>(inlineStorage); }
+
+	alignas(T) unsigned char inlineStorage[N * sizeof(T)];
+	T *elements = inlineElements();  // either inlineStorage, or an array from malloc
+	std::uint32_t count = 0;         // (32 bits is plenty, and keeps an AST node with a ChildList small)
+	std::uint32_t capacity = N;
+};
+
+#endif /*SMALL_VECTOR_H_*/
@@ -0,0 +1,13 @@
+#include "SymbolTable.h"
+
+SymbolID SymbolTable::intern(std::string_view name)
+{
+	auto found = ids.find(name);
+	if (found != ids.end()) {
+		return found->second;
+	}
+	SymbolID id = names.size();
+	names.emplace_back(name);
+	ids.emplace(names.back(), id);
+	return id;
+}
@@ -0,0 +1,30 @@
+#ifndef SYMBOL_TABLE_H_
+#define SYMBOL_TABLE_H_
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+ *  A SymbolTable "interns" identifiers: each different name gets a small integer ID
+ *    (0 for the first name seen, 1 for the next new one, etc.),
+ *    so that the rest of the compiler can compare and look up integers rather than strings.
+ *  Each Lexer has its own SymbolTable, so IDs are only meaningful within one program.
+ */
+
+typedef int SymbolID;
+
+class SymbolTable {
+public:
+	SymbolID intern(std::string_view name);  // the ID for name, giving it a new one if it's new
+	std::string_view name(SymbolID id) const { return names[id]; }
+	int size() const { return names.size(); }
+private:
+	// C++ Usage Note: a deque never moves its elements when it grows (unlike a vector),
+	//   so the string_views used as keys in "ids" stay valid
+	std::deque<std::string> names;
+	std::unordered_map<std::string_view, SymbolID> ids;
+};
+
+#endif /*SYMBOL_TABLE_H_*/
@@ -0,0 +1,35 @@
+#include <logic.h>
+#include "TokenBuffer.h"
+
+TokenBuffer::TokenBuffer()
+{
+}
+
+TokenBuffer::TokenBuffer(Lexer &lexer)
+{
+	while (lexer.getNextToken(), lexer.tokenAvailable()) {
+		append(lexer);
+	}
+}
+
+void TokenBuffer::append(const Lexer &lexer)
+{
+	precondition(lexer.tokenAvailable());
+
+	kinds.push_back(lexer.currentTokenKind());
+	lengths.push_back(lexer.currentTokenLength());
+	values.push_back(lexer.currentTokenValue());
+	if (lexer.textBase() != nullptr) {
+		precondition(base == nullptr || base == lexer.textBase());  // don't mix tokens from different texts
+		base = lexer.textBase();
+		offsets.push_back(lexer.currentTokenOffset());
+	} else {
+		offsets.push_back(copiedText.length());
+		copiedText += lexer.currentTokenView();
+	}
+}
+
+std::string_view TokenBuffer::text(std::size_t i) const
+{
+	return std::string_view((base ? base : copiedText.data()) + offsets[i], lengths[i]);
+}
@@ -0,0 +1,49 @@
+#ifndef TOKEN_BUFFER_H_
+#define TOKEN_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "scanner.h"
+
+/*
+ *  A TokenBuffer holds a sequence of tokens from a Lexer as parallel arrays
+ *    (kind, offset into the text, length, and value; see Lexer::currentTokenValue),
+ *    rather than one object per token,
+ *    so the parser can walk them by index and look as far ahead as it likes.
+ *
+ *  If the Lexer is scanning text in memory, offsets are into that text and nothing is copied;
+ *    otherwise (e.g. the flex Lexer reading standard input), the tokens' text is copied into the buffer.
+ *  The <EOF> token (or end of input) is not stored; it's just the end of the arrays.
+ */
+
+class TokenBuffer {
+public:
+	TokenBuffer();               // empty, to be filled with "append"
+	TokenBuffer(Lexer &lexer);   // lex everything first: all tokens up to end-of-input or <EOF>
+
+	// add the Lexer's current token to the end
+	//  precondition: lexer.tokenAvailable()
+	void append(const Lexer &lexer);
+
+	std::size_t size() const { return kinds.size(); }
+
+	// precondition for these: i < size()
+	kindOfToken kind(std::size_t i) const { return kindOfToken(kinds[i]); }
+	std::uint32_t offset(std::size_t i) const { return offsets[i]; }
+	std::uint32_t length(std::size_t i) const { return lengths[i]; }
+	int value(std::size_t i) const { return values[i]; }
+	std::string_view text(std::size_t i) const;
+private:
+	std::vector<unsigned char> kinds;  // each a kindOfToken, which all fit in a byte
+	std::vector<std::uint32_t> offsets;
+	std::vector<std::uint32_t> lengths;
+	std::vector<int> values;
+
+	const char *base = nullptr;  // the text the offsets are in, when it's the Lexer's
+	std::string copiedText;      // ... or, the tokens' text, when the Lexer isn't scanning memory
+};
+
+#endif /*TOKEN_BUFFER_H_*/
@@ -0,0 +1,84 @@
+#include <utility>
+#include "TypeInference.h"
+
+// This table is indexed by Type, so keep it in the same order as that enum
+static const char *const typeNames[] = { "int", "bool", "unknown", "none", "same as a variable" };
+
+const char *typeName(Type type)
+{
+	return typeNames[type];
+}
+
+InferredType callType(const std::string &funcName)
+{
+	return funcName == "getint" ? INT_TYPE : UNKNOWN_TYPE;
+}
+
+// If the branches have different types, code generation reports that, so this just gives back
+//   something that won't cause more errors above it.  If one branch's type depends on a variable,
+//   and the other's is known, this gives the known one (code generation checks that they match).
+InferredType ifType(InferredType expriftrue, InferredType expriffalse)
+{
+	if (expriftrue == expriffalse || expriffalse.type == UNKNOWN_TYPE) return expriftrue;
+	if (expriftrue.type == UNKNOWN_TYPE) return expriffalse;
+	if (expriftrue.isKnown() && expriffalse.isKnown()) return UNKNOWN_TYPE;
+	return expriffalse.isKnown() ? expriffalse : expriftrue;
+}
+
+InferredType TypeInference::visitIf(const IfNode &node)
+{
+	return ifType(resultFor(node.getIfTrue()), resultFor(node.getIfFalse()));
+}
+
+InferredType TypeInference::visitLet(const LetNode &node)
+{
+	if (node.getExpressions().empty()) return NO_TYPE;
+	if (node.getDeclarations().kind() != DECLARATIONS_NODE) throw "TypeInference given a let* without declarations";
+	const ChildList &declarations = static_cast<const DeclarationsNode *>(node.getDeclarations().node())->getDeclarations();
+	return letType(declarations.size(),
+		[&](std::size_t i) {
+			if (declarations[i].kind() != DECLARATION_NODE) throw "TypeInference given declarations with something else in them";
+			const DeclarationNode *declaration = static_cast<const DeclarationNode *>(declarations[i].node());
+			return std::make_pair(declaration->getVariable(), resultFor(declarations[i]));
+		},
+		resultFor(node.getExpressions()[0]));
+}
+
+// Since each entry comes after its children, one pass through the entries, in order, does them all
+std::vector<InferredType> inferTypes(const FlatAST &program)
+{
+	std::vector<InferredType> types;
+	types.reserve(program.size());
+	for (FlatAST::Index i = 0; i < program.size(); i++) {
+		switch (program.kind(i)) {
+			case INT_LITERAL_NODE:  types.push_back(INT_TYPE); break;
+			case BOOL_LITERAL_NODE: types.push_back(BOOL_TYPE); break;
+			case VAR_USE_NODE:      types.push_back(InferredType::sameAs(program.payload(i))); break;
+			case COMPARISON_NODE:   types.push_back(BOOL_TYPE); break;
+			case ARITHMETIC_NODE:   types.push_back(INT_TYPE); break;
+			case CALL_NODE:         types.push_back(callType(program.name(program.payload(i)))); break;
+			case DECLARATIONS_NODE: types.push_back(NO_TYPE); break;
+			case DECLARATION_NODE:  types.push_back(types[i - 1]); break;  // (its value ends right before it)
+			case IF_NODE: {
+				FlatAST::IndexList children = program.children(i);
+				types.push_back(ifType(types[children[1]], types[children[2]]));
+				break;
+			}
+			case LET_NODE: {
+				FlatAST::IndexList children = program.children(i);  // (the declarations, then the expressions)
+				InferredType first = children.size() > 1 ? types[children[1]] : InferredType(NO_TYPE);
+				if (first.type == SAME_AS_VARIABLE) {
+					FlatAST::IndexList declarations = program.children(children[0]);
+					first = letType(declarations.size(),
+						[&](std::size_t d) { return std::make_pair(SymbolID(program.payload(declarations[d])), types[declarations[d]]); },
+						first);
+				}
+				types.push_back(first);
+				break;
+			}
+			default:
+				throw "inferTypes given an entry of unknown kind";
+		}
+	}
+	return types;
+}
@@ -0,0 +1,90 @@
+#ifndef TYPE_INFERENCE_H_
+#define TYPE_INFERENCE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AST.h"
+#include "FlatAST.h"
+#include "PassManager.h"
+
+/*
+ *  Type inference works out the type of every expression once, before code generation,
+ *    so that code generation's type checks (and later passes) just look the types up,
+ *    rather than each node looking at its children's kinds.
+ *  Types are worked out through let*s (a variable has the type of its value) and ifs
+ *    (which have the type of their branches), however deep those are.
+ *
+ *  A node's type can only depend on its own subtree (see PassManager.h), but a variable's type
+ *    depends on which declaration it refers to, so an expression whose type is that of a variable
+ *    declared outside of it (e.g. "x", or "(if c x y)") gets the type "same as variable x";
+ *    the let* that declares x works that out for its own value, and code generation,
+ *    which knows all the variables declared so far, does so for the rest (see "resolve" in generateHERA.cc).
+ */
+
+// The types of expressions:
+//   UNKNOWN_TYPE is for a call that may give back anything (i.e. "exit", which doesn't give anything back),
+//   and fits wherever an integer or boolean is needed;
+//   NO_TYPE is for a variable that hasn't been declared, or for a declaration, which isn't an expression;
+//   SAME_AS_VARIABLE is only used in an InferredType, below
+enum Type : unsigned char { INT_TYPE, BOOL_TYPE, UNKNOWN_TYPE, NO_TYPE, SAME_AS_VARIABLE };
+const char *typeName(Type type);  // e.g. "int" for INT_TYPE
+
+// What type inference knows about an expression's type from the expression alone
+struct InferredType {
+	Type type;
+	SymbolID variable;  // for SAME_AS_VARIABLE: the variable whose type this is
+
+	InferredType(Type type) : type(type), variable(-1) { }
+	static InferredType sameAs(SymbolID variable) { InferredType t(SAME_AS_VARIABLE); t.variable = variable; return t; }
+
+	bool operator==(InferredType other) const { return type == other.type && variable == other.variable; }
+	bool isKnown() const { return type == INT_TYPE || type == BOOL_TYPE; }
+};
+
+// the rules for each kind of expression whose type depends on more than its kind,
+//   shared by the tree and FlatAST versions below
+InferredType callType(const std::string &funcName);
+InferredType ifType(InferredType expriftrue, InferredType expriffalse);
+
+// the type of a let*'s value, given its declarations and its first expression's type
+//   (code generation puts the first expression's value in the let*'s register, and the others below it):
+//   if that's the type of a variable the let* declares, it's the type of that variable's value
+//   (which may in turn be the type of a variable declared before it, and so on);
+//   "declaration(i)" gives the variable and its value's type for the i'th declaration (in order),
+//   as a std::pair<SymbolID, InferredType>
+template <typename Declaration>
+InferredType letType(std::size_t declarations, Declaration declaration, InferredType first)
+{
+	std::size_t i = declarations;
+	while (first.type == SAME_AS_VARIABLE && i > 0) {  // look back for the latest declaration of that variable
+		i--;
+		auto [variable, type] = declaration(i);
+		if (variable == first.variable) first = type;
+	}
+	return first;
+}
+
+
+// The type inference pass, for trees; after it has run, resultFor gives each node's type
+//   (the result for a declaration is its value's type, and for the declarations of a let* is NO_TYPE)
+class TypeInference : public Analysis<InferredType> {
+public:
+	TypeInference() : Analysis<InferredType>("type inference") { }
+protected:
+	InferredType visitInteger(int) { return INT_TYPE; }
+	InferredType visitBoolean(bool) { return BOOL_TYPE; }
+	InferredType visitVariable(SymbolID variable) { return InferredType::sameAs(variable); }
+	InferredType visitComparison(const ComparisonNode &) { return BOOL_TYPE; }
+	InferredType visitArithmetic(const ArithmeticNode &) { return INT_TYPE; }
+	InferredType visitCall(const CallNode &node) { return callType(node.getName()); }
+	InferredType visitIf(const IfNode &node);
+	InferredType visitLet(const LetNode &node);
+	InferredType visitDeclarations(const DeclarationsNode &) { return NO_TYPE; }
+	InferredType visitDeclaration(const DeclarationNode &node) { return resultFor(node.getValue()); }
+};
+
+// The same, for a FlatAST: the type of each entry, at the same index
+std::vector<InferredType> inferTypes(const FlatAST &program);
+
+#endif /*TYPE_INFERENCE_H_*/
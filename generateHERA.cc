@@ -1,238 +1,804 @@
+#include <cstdlib>
+#include <vector>
 #include "AST.h"
+#include "FlatAST.h"
 #include "ContextInfo.h"
-#include "hc_list_helpers.h"
+#include "TypeInference.h"
+#include "HERACode.h"
+#include "Peephole.h"
+#include "CostModel.h"
+#include "ConstantFolding.h"
+#include "RegisterNeeds.h"
 #include "streams.h"
 
 using std::string;
 using std::endl;
 
-Dictionary declarationDict = Dictionary();
-int FPoffset = -1;
+// one of each per thread, so that separate threads can generate code for separate programs
+thread_local Dictionary declarationDict = Dictionary();
+thread_local int FPoffset = -1;
+static thread_local Diagnostics *diagnostics = nullptr;  // where to report type errors
+static thread_local TypeInference *nodeTypes = nullptr;  // the type of each node (see TypeInference.h)
+static thread_local RegisterNeeds *nodeNeeds = nullptr;   // and its register need (see RegisterNeeds.h)
+static thread_local std::vector<Type> variableTypes;      // the type of each variable declared so far, by SymbolID
+static thread_local std::vector<bool> zeroOrOneVariables; // and whether it's sure to hold 0 or 1 (see isZeroOrOne)
 
-std::string generateFullHERA(ExprNode *presumedRoot)
+HERACode generateHERACode(ExprHandle presumedRoot, Diagnostics &problems, TypeInference &inferredTypes)
 {
-    return "\nCBON()\n" + presumedRoot->generateHERA(ContextInfo());
+    declarationDict = Dictionary();  // start fresh for each program
+    FPoffset = -1;
+    variableTypes.clear();
+    zeroOrOneVariables.clear();
+    diagnostics = &problems;
+    nodeTypes = &inferredTypes;
+    RegisterNeeds needs;  // (which works out the needs as they're asked for)
+    nodeNeeds = &needs;
+
+    HERACode code;
+    code.cbon();
+    presumedRoot.generateHERA(ContextInfo(), code);
+    return code;
 }
 
-string IntLiteralNode::generateHERA(const ContextInfo &context) const
+// the code as text, after the peephole optimizer (see Peephole.h) has tidied it up,
+//   unless HAVERRACKET_PEEPHOLE is #f
+static string finishedText(HERACode code)
 {
-	trace << "Entered IntLiteralNode::generateHERA for integer " + std::to_string(v) << endl;
-	return "SET(" + context.getReg() + ", " + std::to_string(v) + ")\n";
+    const char *peepholeSetting = getenv("HAVERRACKET_PEEPHOLE");
+    if (!peepholeSetting || peepholeSetting != string("#f")) {
+        std::size_t generated = code.size();
+        std::size_t removed = peephole(code, ContextInfo().getRegNumber());
+        trace << "Peephole optimizer removed " << removed << " of " << generated << " instructions" << endl;
+    }
+    return "\n" + code.text();
 }
 
-string BoolLiteralNode::generateHERA(const ContextInfo &context) const
+std::string generateFullHERA(ExprHandle presumedRoot, Diagnostics &problems, TypeInference &inferredTypes)
 {
-    trace << "Entered BoolLiteralNode::generateHERA for boolean " + std::to_string(v) << endl;
-    return "SET(" + context.getReg() + ", " + std::to_string(v) + ")\n";
+    return finishedText(generateHERACode(presumedRoot, problems, inferredTypes));
 }
 
-std::string HERA_op(const std::string &AST_op_name)
+std::string generateFullHERA(ExprHandle presumedRoot, Diagnostics &problems)
 {
-	if (AST_op_name == "+") {
-		return "ADD";
-	} else if (AST_op_name == "-") {
-		return "SUB";
-	} else if (AST_op_name == "*") {
-		return "MUL";
-    } else if (AST_op_name == "=") {
-        return "CMP";
-    } else if (AST_op_name == ">=") {
-        return "CMP";
-    } else if (AST_op_name == "<=") {
-        return "CMP";
-	} else {
-		throw "Internal compiler inconsistency/incompleteness: HERA_op not implemented for " + AST_op_name;
-	}
+    TypeInference inferredTypes;  // (which works out the types as they're needed)
+    return generateFullHERA(presumedRoot, problems, inferredTypes);
 }
 
-string ComparisonNode::generateHERA(const ContextInfo &context) const
+// report a type error, then carry on generating code (which the caller shouldn't use)
+static void typeError(int exitCode, const string &message)
 {
-    trace << "Entered ComparisonNode::generateHERA for comparison " + o << endl;
+    diagnostics->report(exitCode, "\n!Type error! " + message);
+}
 
-    // see arithmetic node for more about the "context" stuff:
-    //	trace << "need to compare the result of left-hand-side:\n" << left->generateHERA(context) << endl;
-    //	trace << "                        with right-hand-side:\n" << left->generateHERA(context.evalThisAfter()) << endl;
+// The checks and code for each kind of node are in the functions below,
+//   so the tree (ExprNode) and FlatAST versions of the code generator both use them;
+//   they just differ in how they get to the children
 
-    if (left->getType() != "CallNode" && right->getType() != "CallNode") {
-        if ((left->getType() != "IntLiteralNode" && left->getType() != "VarUseNode" && left->getType() != "LetNode") ||
-                (right->getType() != "IntLiteralNode" && right->getType() != "VarUseNode" && right->getType() != "LetNode")) {
-            cerr << endl << "!Type error! cannot perform comparison operations on non-integers" << endl;
-            exit(98);
-        }
+// the type of an expression here, i.e. with the type of the variable it depends on, if it does
+static Type resolve(InferredType type)
+{
+    if (type.type != SAME_AS_VARIABLE) return type.type;
+    return std::size_t(type.variable) < variableTypes.size() ? variableTypes[type.variable] : NO_TYPE;
+}
+
+static InferredType typeOf(ExprHandle e)
+{
+    return nodeTypes->resultFor(e);
+}
+
+static RegisterNeed needOf(ExprHandle e)
+{
+    return nodeNeeds->resultFor(e);
+}
+
+// the operands of arithmetic or a comparison must be integers (or calls, which might be)
+static void checkIntegerOperands(InferredType left, InferredType right, int exitCode, const string &message)
+{
+    Type leftType = resolve(left), rightType = resolve(right);
+    if ((leftType != INT_TYPE && leftType != UNKNOWN_TYPE) || (rightType != INT_TYPE && rightType != UNKNOWN_TYPE)) {
+        typeError(exitCode, message);
     }
+}
 
-    ContextInfo rhsContext = context.evalThisAfter();
-    ContextInfo lhsContext = context;  // just named for symmetry
+static void checkBranchTypes(InferredType expriftrue, InferredType expriffalse)
+{
+    Type trueType = resolve(expriftrue), falseType = resolve(expriffalse);
+    if (trueType != falseType && trueType != UNKNOWN_TYPE && falseType != UNKNOWN_TYPE) {
+        typeError(45, "\"then\" and \"else\" statements must be of the same type");
+    }
+}
 
-    ContextInfo labelContext1 = ContextInfo();
-    ContextInfo endLabelContext = ContextInfo();
+// the code for an integer, boolean, or variable use
+static void immediateHERA(NodeKind kind, int value, const ContextInfo &context, HERACode &code)
+{
+    if (kind == VAR_USE_NODE) {
+        code.load(context.getRegNumber(), declarationDict.lookup(value), FP);
+    } else {
+        code.set(context.getRegNumber(), value);
+    }
+}
 
-    return left->generateHERA(lhsContext) +
-           right->generateHERA(rhsContext) +
-           HERA_op(o)+"("+lhsContext.getReg()+", "+rhsContext.getReg()+")\n" +
-           "BZ(" + context.getLabel() + ")\n" +
-            ((o == "=")? "SET(" + context.getReg() + ", " + "0)\n" :
-             (o == "<=" || o == ">=")? "BS(" + labelContext1.getLabel() + ")\n" : "") +
-            ((o == ">=")? "SET(" + context.getReg() + ", " + "1)\n" :
-             (o == "<=")? "SET(" + context.getReg() + ", " + "0)\n" : "") +
-            "BR(" + endLabelContext.getLabel() + ")\n" +
-            "LABEL(" + context.getLabel() + ")\n" +
-            "SET(" + context.getReg() + ", " + "1)\n" +
-            "BR(" + endLabelContext.getLabel() + ")\n" +
-            ((o == "<=" || o == ">=")? ("LABEL(" + labelContext1.getLabel() + ")\n" +
-            ((o == "<=")? "SET(" + context.getReg() + ", " + "1)\n" :
-             "SET(" + context.getReg() + ", " + "0)\n")) : "") +
-             "LABEL(" + endLabelContext.getLabel() + ")\n";
-}
-
-string ArithmeticNode::generateHERA(const ContextInfo &context) const
-{
-	trace << "Entered ArithmeticNode::generateHERA for operator " + o << endl;
-	if (length(subexps) != 2) {
-		throw "compiler incomplete/inconsistent: generateHERA not implemented for non-binary arithmetic";
+// Integers, booleans, and variable uses are immediates (see ExprHandle in AST.h),
+//   so their code is generated here, rather than by a node class
+void ExprHandle::generateHERA(const ContextInfo &context, HERACode &code) const
+{
+	switch (kind()) {
+		case INT_LITERAL_NODE:
+			trace << "Entered IntLiteralNode::generateHERA for integer " << value() << endl;
+			immediateHERA(INT_LITERAL_NODE, value(), context, code);
+			break;
+		case BOOL_LITERAL_NODE:
+			trace << "Entered BoolLiteralNode::generateHERA for boolean " << value() << endl;
+			immediateHERA(BOOL_LITERAL_NODE, value(), context, code);
+			break;
+		case VAR_USE_NODE:
+			trace << "Entered VarUseNode::generateHERA for variable #" << value() << endl;
+			immediateHERA(VAR_USE_NODE, value(), context, code);
+			break;
+		default:
+			node()->generateHERA(context, code);
 	}
+}
+
+// These tables are indexed by Operator (see AST.h), so keep them in the same order as that enum
+static const char *const operatorNames[] = { "+",   "-",   "*",   "=",   "<=",  ">=",  "<",   ">",   "!=" };
+static const HERAOpcode HERA_ops[]       = { HERA_ADD, HERA_SUB, HERA_MUL, HERA_CMP, HERA_CMP, HERA_CMP, HERA_CMP, HERA_CMP, HERA_CMP };
+// the branch to take after a comparison's CMP if it's true, and if it's false (the arithmetic operators don't have one)
+static const HERAOpcode branchIfTrue[]   = { HERA_BR, HERA_BR, HERA_BR, HERA_BZ,  HERA_BLE, HERA_BGE, HERA_BL,  HERA_BG,  HERA_BNZ };
+static const HERAOpcode branchIfFalse[]  = { HERA_BR, HERA_BR, HERA_BR, HERA_BNZ, HERA_BG,  HERA_BL,  HERA_BGE, HERA_BLE, HERA_BZ };
+
+const char *operatorName(Operator op)
+{
+	return operatorNames[op];
+}
 
-    if (first(subexps)->getType() != "CallNode" && first(rest(subexps))->getType() != "CallNode") {
-        if ((first(subexps)->getType() != "IntLiteralNode" && first(subexps)->getType() != "VarUseNode" && first(subexps)->getType() != "LetNode") ||
-                (first(rest(subexps))->getType() != "IntLiteralNode" && first(rest(subexps))->getType() != "VarUseNode" && first(rest(subexps))
-                ->getType() != "LetNode")) {
-            cerr << endl << "!Type error! cannot perform arithmetic operations on non-integers" << endl;
-            exit(99);
+// the code after a comparison's operands, to turn the flags into 0 or 1
+//   (the label has a ContextInfo of its own, since "context" may be shared with e.g. the let* this is in)
+static void comparisonHERA(Operator o, const ContextInfo &context, const ContextInfo &lhsContext, const ContextInfo &rhsContext,
+                           const ContextInfo &endLabelContext, HERACode &code)
+{
+    int reg = context.getRegNumber();
+    code.cmp(lhsContext.getRegNumber(), rhsContext.getRegNumber());
+    code.set(reg, 1);  // (SET leaves the flags alone)
+    code.branch(branchIfTrue[o], endLabelContext.getLabelNumber());
+    code.set(reg, 0);
+    code.label(endLabelContext.getLabelNumber());
+}
+
+// the same, without branches: SAVEF puts the flags from the CMP in "context"'s register (see HERACode.h),
+//   and the bit that's wanted is shifted down to bit 0 (for "<", the sign XOR the overflow),
+//   using the register of whichever operand isn't in "context"'s as well
+static void comparisonBitHERA(Operator o, const ContextInfo &context, const ContextInfo &lhsContext, const ContextInfo &rhsContext,
+                              HERACode &code)
+{
+    int reg = context.getRegNumber(), lhs = lhsContext.getRegNumber(), rhs = rhsContext.getRegNumber();
+    int other = (lhs == reg ? rhs : lhs);
+    bool orEqual = (o == OP_LESS_EQUAL || o == OP_GREATER);  // (">" is the opposite of "<=")
+    bool opposite = (o == OP_NOT_EQUAL || o == OP_GREATER_EQUAL || o == OP_GREATER);
+    code.cmp(lhs, rhs);
+    code.savef(reg);
+    if (o == OP_EQUAL || o == OP_NOT_EQUAL) {
+        code.lsr(reg, reg);  // the zero flag
+    } else {
+        code.lsr(other, reg);
+        code.lsr(other, other);  // the overflow flag
+        if (orEqual) {
+            code.arithmetic(HERA_XOR, other, reg, other);
+            code.lsr(reg, reg);
+            code.arithmetic(HERA_OR, reg, reg, other);
+        } else {
+            code.arithmetic(HERA_XOR, reg, reg, other);
         }
     }
+    code.set(other, 1);
+    code.arithmetic(HERA_AND, reg, reg, other);
+    if (opposite) code.arithmetic(HERA_XOR, reg, reg, other);
+}
 
-	ContextInfo rhsContext = context.evalThisAfter();
-	ContextInfo lhsContext = context;  // just named for symmetry
+// add whichever of two ways of doing the same thing the cost model (see CostModel.h) expects to be faster,
+//   or the one without branches, if neither is
+static void appendFaster(const HERACode &branchy, const HERACode &branchless, HERACode &code)
+{
+    double withBranches = expectedCycles(branchy), without = expectedCycles(branchless);
+    trace << "Cost model expects " << withBranches << " cycles with branches, " << without << " without" << endl;
+    code.append(without <= withBranches ? branchless : branchy);
+}
 
-    string leftHERA = first(subexps)->generateHERA(lhsContext);
-    string rightHERA = first(rest(subexps))->generateHERA(rhsContext);
+// the code after a comparison's operands, made with branches (comparisonHERA) or without (comparisonBitHERA)
+static void comparisonValueHERA(Operator o, const ContextInfo &context, const ContextInfo &lhsContext, const ContextInfo &rhsContext,
+                                const ContextInfo &endLabelContext, HERACode &code)
+{
+    HERACode branchy, branchless;
+    comparisonHERA(o, context, lhsContext, rhsContext, endLabelContext, branchy);
+    comparisonBitHERA(o, context, lhsContext, rhsContext, branchless);
+    appendFaster(branchy, branchless, code);
+}
 
-    return  leftHERA + rightHERA + HERA_op(o)+"("+context.getReg()+", "+lhsContext.getReg()+", "+rhsContext.getReg()+")\n";
+// the code after the operands of an if's condition, when that's a comparison:
+//   rather than making 0 or 1 and testing that, go straight to the if's "else" if the comparison is false
+static void comparisonBranchHERA(Operator o, const ContextInfo &lhsContext, const ContextInfo &rhsContext,
+                                 const ContextInfo &falseLabelContext, HERACode &code)
+{
+    code.cmp(lhsContext.getRegNumber(), rhsContext.getRegNumber());
+    code.branch(branchIfFalse[o], falseLabelContext.getLabelNumber());
 }
 
-string VarUseNode::generateHERA(const ContextInfo &context) const
+void ComparisonNode::generateHERA(const ContextInfo &context, HERACode &code) const
 {
-	trace << "Entered VarUseNode::generateHERA for variable " + n << endl;
+    trace << "Entered ComparisonNode::generateHERA for comparison " << operatorName(o) << endl;
 
-    return "LOAD(" + context.getReg() + ", " + to_string(declarationDict.lookup(n)) + ", FP)\n";
+    // see arithmetic node for more about the "context" stuff, and RegisterNeeds.h for the order of the operands:
+    //	trace << "need to compare the result of left-hand-side:\n" << left->generateHERA(context) << endl;
+    //	trace << "                        with right-hand-side:\n" << left->generateHERA(context.evalThisAfter()) << endl;
+
+    checkIntegerOperands(typeOf(left), typeOf(right), 98, "cannot perform comparison operations on non-integers");
+
+    ContextInfo laterContext = context.evalThisAfter();
+    bool rightFirst = evaluateRightFirst(needOf(left), needOf(right), context.registersLeft());
+    ContextInfo lhsContext = rightFirst ? laterContext : context;
+    ContextInfo rhsContext = rightFirst ? context : laterContext;
+
+    ContextInfo endLabelContext = ContextInfo();
+
+    (rightFirst ? right : left).generateHERA(context, code);
+    (rightFirst ? left : right).generateHERA(laterContext, code);
+    comparisonValueHERA(o, context, lhsContext, rhsContext, endLabelContext, code);
 }
 
-string CallNode::generateHERA(const ContextInfo &context) const
+void ComparisonNode::generateBranchHERA(const ContextInfo &context, const ContextInfo &falseLabelContext, HERACode &code) const
 {
-	trace << "Entered CallNode::generateHERA for call to " + n << endl;
-	
-	if (length(argList) != 0 || (n != "exit" && n != "getint")) {
+    trace << "Entered ComparisonNode::generateBranchHERA for comparison " << operatorName(o) << endl;
+
+    checkIntegerOperands(typeOf(left), typeOf(right), 98, "cannot perform comparison operations on non-integers");
+
+    ContextInfo laterContext = context.evalThisAfter();
+    bool rightFirst = evaluateRightFirst(needOf(left), needOf(right), context.registersLeft());
+    ContextInfo lhsContext = rightFirst ? laterContext : context;
+    ContextInfo rhsContext = rightFirst ? context : laterContext;
+
+    (rightFirst ? right : left).generateHERA(context, code);
+    (rightFirst ? left : right).generateHERA(laterContext, code);
+    comparisonBranchHERA(o, lhsContext, rhsContext, falseLabelContext, code);
+}
+
+// the instruction after the operands of arithmetic
+static void arithmeticHERA(Operator o, const ContextInfo &context, const ContextInfo &lhsContext, const ContextInfo &rhsContext,
+                           HERACode &code)
+{
+    code.arithmetic(HERA_ops[o], context.getRegNumber(), lhsContext.getRegNumber(), rhsContext.getRegNumber());
+}
+
+void ArithmeticNode::generateHERA(const ContextInfo &context, HERACode &code) const
+{
+	trace << "Entered ArithmeticNode::generateHERA for operator " << operatorName(o) << endl;
+	if (subexps.size() != 2) {
+		throw "compiler incomplete/inconsistent: generateHERA not implemented for non-binary arithmetic";
+	}
+
+    checkIntegerOperands(typeOf(subexps[0]), typeOf(subexps[1]), 99, "cannot perform arithmetic operations on non-integers");
+
+	ContextInfo laterContext = context.evalThisAfter();
+	bool rightFirst = evaluateRightFirst(needOf(subexps[0]), needOf(subexps[1]), context.registersLeft());
+	ContextInfo lhsContext = rightFirst ? laterContext : context;
+	ContextInfo rhsContext = rightFirst ? context : laterContext;
+
+    subexps[rightFirst ? 1 : 0].generateHERA(context, code);
+    subexps[rightFirst ? 0 : 1].generateHERA(laterContext, code);
+    arithmeticHERA(o, context, lhsContext, rhsContext, code);
+}
+
+static void callHERA(const string &n, bool anyArguments, const ContextInfo &context, HERACode &code)
+{
+	if (anyArguments || (n != "exit" && n != "getint")) {
 		throw "compiler incomplete/inconsistent: generateHERA for calls only implented for getint and exit";
 	}
 	// NOTE that calls to exit and getint don't need parameters and don't perturb registers
-	return ("MOVE(FP_alt, SP)\nCALL(FP_alt," + n + ")\n"+
-		(context.getReg()=="R1"?"":"MOVE("+context.getReg()+", R1)\n"));
+	code.move(FP_ALT, SP);
+	code.call(FP_ALT, n);
+	if (context.getRegNumber() != 1) {
+		code.move(context.getRegNumber(), 1);
+	}
 }
 
-string IfNode::generateHERA(const ContextInfo &context) const
+void CallNode::generateHERA(const ContextInfo &context, HERACode &code) const
 {
-    trace << "Entered IfNode::generateHERA" << endl;
+	trace << "Entered CallNode::generateHERA for call to " + n << endl;
+	callHERA(n, !argList.empty(), context, code);
+}
 
-    if (expriftrue->getType() != "CallNode" && expriffalse->getType() != "CallNode") {
-        if (expriftrue->getType() != expriffalse->getType()) {
-            cerr << endl << "!Type error! \"then\" and \"else\" statements must be of the same type" << endl;
-            exit(45);
-        }
-    }
+// An if runs only the branch it takes: the condition, then a branch past "then" if it's false,
+//   "then", a branch past "else", and "else"; the condition and both branches all use the if's own register,
+//   since the condition isn't needed once it's been tested, and only one branch runs.
+// A condition that's a comparison doesn't make 0 or 1 at all: its CMP is followed by the branch past "then"
+//   (see comparisonBranchHERA); any other condition's value is tested here.
 
-    ContextInfo conditionContext = context;
-    ContextInfo expriftrueContext = context.evalThisAfter();
-    ContextInfo expriffalseContext = context.evalThisAfter().evalThisAfter();
+// the code after the condition, to skip "then" if it's false
+static void ifConditionHERA(const ContextInfo &context, const ContextInfo &elseLabelContext, HERACode &code)
+{
+    code.flags(context.getRegNumber());
+    code.branch(HERA_BZ, elseLabelContext.getLabelNumber());
+}
 
-    ContextInfo labelContext1 = ContextInfo();
-    ContextInfo labelContext2 = ContextInfo();
+// the code between "then" and "else"
+static void ifElseHERA(const ContextInfo &elseLabelContext, const ContextInfo &endLabelContext, HERACode &code)
+{
+    code.branch(HERA_BR, endLabelContext.getLabelNumber());
+    code.label(elseLabelContext.getLabelNumber());
+}
 
-    string conditionHERA = condition->generateHERA(conditionContext);
-    string expriftrueHERA = expriftrue->generateHERA(expriftrueContext);
-    string expriffalseHERA = expriffalse->generateHERA(expriffalseContext);
+// the code after "else"
+static void ifEndHERA(const ContextInfo &endLabelContext, HERACode &code)
+{
+    code.label(endLabelContext.getLabelNumber());
+}
 
-    return  conditionHERA + expriftrueHERA + expriffalseHERA +
-            "FLAGS(" + conditionContext.getReg() + ")\n" +
-            "BZ(" + labelContext1.getLabel() + ")\n" +
-            "MOVE(" + context.getReg() + ", " + expriftrueContext.getReg() + ")\n" +
-            "BR(" + labelContext2.getLabel() + ")\n" +
-            "LABEL(" + labelContext1.getLabel() + ")\n" +
-            "MOVE(" + context.getReg() + ", " + expriffalseContext.getReg() + ")\n" +
-            "LABEL(" + labelContext2.getLabel() + ")\n";
+// An if whose branches are immediates (so they're cheap, and can't do anything but give a value) is a "simple select",
+//   if its condition is sure to be 0 or 1 (but isn't a comparison, which is better tested right after its CMP),
+//   and there's room for two more registers below the if's (see ContextInfo::evalThisAfter):
+//   then it can be done without branches, as y + c * (x - y), for (if c x y); see selectHERA.
+// Whether it's done that way is up to the cost model (see CostModel.h): with constant branches it usually is,
+//   e.g. (if c 5 0) is c * 5, but two LOADs cost more than the branches they'd replace.
+namespace {
+struct Immediate {
+    NodeKind kind;
+    int value;
+};
 }
 
-string LetNode::generateHERA(const ContextInfo &context) const
+static bool isZeroOrOne(Immediate e)
 {
-    trace << "Entered LetNode::generateHERA" << endl;
-    ContextInfo declarationsContext = context;
-    ContextInfo expressionsContext = context;
+    switch (e.kind) {
+        case BOOL_LITERAL_NODE: return true;
+        case INT_LITERAL_NODE:  return e.value == 0 || e.value == 1;
+        case VAR_USE_NODE:      return std::size_t(e.value) < zeroOrOneVariables.size() && zeroOrOneVariables[e.value];
+        default:                return false;
+    }
+}
+
+// whether an expression's value is sure to be 0 or 1: a comparison's is, and so is an if's whose branches are
+//   (having the type bool isn't enough, since e.g. (if c (getint) #t) has that type)
+static bool isZeroOrOne(ExprHandle e)
+{
+    if (e.isImmediate()) return isZeroOrOne(Immediate{ e.kind(), e.value() });
+    if (e.kind() == COMPARISON_NODE) return true;
+    if (e.kind() != IF_NODE) return false;
+    const IfNode &node = static_cast<const IfNode &>(*e.node());
+    ExprHandle expriftrue = node.getIfTrue(), expriffalse = node.getIfFalse();
+    return expriftrue.isImmediate() && expriffalse.isImmediate() &&
+           isZeroOrOne(Immediate{ expriftrue.kind(), expriftrue.value() }) && isZeroOrOne(Immediate{ expriffalse.kind(), expriffalse.value() });
+}
 
-    string expressionsHERA = "";
-    string declarationsHERA = declarations->generateHERA(declarationsContext);
-    expressionsHERA = expressionsHelper(expressionsHERA, expressions, expressionsContext);
-    return declarationsHERA + expressionsHERA;
+static bool isSimpleSelect(ExprHandle condition, ExprHandle expriftrue, ExprHandle expriffalse, const ContextInfo &context)
+{
+    return expriftrue.isImmediate() && expriffalse.isImmediate() && condition.kind() != COMPARISON_NODE &&
+           isZeroOrOne(condition) && context.getRegNumber() > 2;
 }
 
-string LetNode::expressionsHelper(string expressionsHERA, HaverfordCS::list<ExprNode *> expressions, ContextInfo context) const {
-    if (empty(expressions)) {
-        return expressionsHERA;
+// the code after a simple select's condition, which is in "context"'s register: its branches, with branches or without,
+//   the latter using the registers of "firstContext" and "secondContext"
+static void selectHERA(Immediate expriftrue, Immediate expriffalse, const ContextInfo &context,
+                       const ContextInfo &firstContext, const ContextInfo &secondContext,
+                       const ContextInfo &elseLabelContext, const ContextInfo &endLabelContext, HERACode &code)
+{
+    HERACode branchy;
+    ifConditionHERA(context, elseLabelContext, branchy);
+    immediateHERA(expriftrue.kind, expriftrue.value, context, branchy);
+    ifElseHERA(elseLabelContext, endLabelContext, branchy);
+    immediateHERA(expriffalse.kind, expriffalse.value, context, branchy);
+    ifEndHERA(endLabelContext, branchy);
+
+    HERACode branchless;
+    int reg = context.getRegNumber(), first = firstContext.getRegNumber(), second = secondContext.getRegNumber();
+    if (expriftrue.kind != VAR_USE_NODE && expriffalse.kind != VAR_USE_NODE) {
+        // x - y is a constant, so e.g. (if c #t #f) is just c
+        int difference = foldArithmetic(OP_MINUS, expriftrue.value, expriffalse.value);
+        if (difference == 0) {
+            branchless.set(reg, expriffalse.value);
+        } else {
+            if (difference != 1) {
+                branchless.set(first, difference);
+                branchless.arithmetic(HERA_MUL, reg, reg, first);
+            }
+            if (expriffalse.value != 0) {
+                branchless.set(first, expriffalse.value);
+                branchless.arithmetic(HERA_ADD, reg, reg, first);
+            }
+        }
+    } else if (expriffalse.kind != VAR_USE_NODE && expriffalse.value == 0) {
+        immediateHERA(expriftrue.kind, expriftrue.value, firstContext, branchless);
+        branchless.arithmetic(HERA_MUL, reg, reg, first);
+    } else {
+        immediateHERA(expriftrue.kind, expriftrue.value, firstContext, branchless);
+        immediateHERA(expriffalse.kind, expriffalse.value, secondContext, branchless);
+        branchless.arithmetic(HERA_SUB, first, first, second);
+        branchless.arithmetic(HERA_MUL, reg, reg, first);
+        branchless.arithmetic(HERA_ADD, reg, reg, second);
     }
-    return expressionsHelper(expressionsHERA += first(expressions)->generateHERA(context), rest(expressions), context.evalThisAfter());
+    appendFaster(branchy, branchless, code);
 }
 
-string DeclarationsNode::generateHERA(const ContextInfo &context) const
+void IfNode::generateHERA(const ContextInfo &context, HERACode &code) const
 {
-    trace << "Entered DeclarationsNode::generateHERA" << endl;
-    ContextInfo declarationsContext = context;
+    trace << "Entered IfNode::generateHERA" << endl;
 
-    ContextInfo labelContext = ContextInfo();
+    checkBranchTypes(typeOf(expriftrue), typeOf(expriffalse));
+
+    ContextInfo elseLabelContext = ContextInfo();
+    ContextInfo endLabelContext = ContextInfo();
+
+    if (isSimpleSelect(condition, expriftrue, expriffalse, context)) {
+        ContextInfo firstContext = context.evalThisAfter();
+        ContextInfo secondContext = firstContext.evalThisAfter();
+        condition.generateHERA(context, code);
+        selectHERA(Immediate{ expriftrue.kind(), expriftrue.value() }, Immediate{ expriffalse.kind(), expriffalse.value() },
+                   context, firstContext, secondContext, elseLabelContext, endLabelContext, code);
+        return;
+    }
+    if (condition.kind() == COMPARISON_NODE) {
+        static_cast<const ComparisonNode *>(condition.node())->generateBranchHERA(context, elseLabelContext, code);
+    } else {
+        condition.generateHERA(context, code);
+        ifConditionHERA(context, elseLabelContext, code);
+    }
+    expriftrue.generateHERA(context, code);
+    ifElseHERA(elseLabelContext, endLabelContext, code);
+    expriffalse.generateHERA(context, code);
+    ifEndHERA(endLabelContext, code);
+}
 
-    string declarationsHERA = "";
-    return  declarationsHelper(declarationsHERA, declarations, context);
+// A let*'s variables are only declared inside it, so once it's done, any variables of the same names
+//   from outside it are back (which matters now that e.g. an if's "else" doesn't run after its "then"):
+//   a Scope remembers what to put back (each variable keeps its own place in the frame, though)
+namespace {
+struct Shadowed {
+    SymbolID variable;
+    Type type;       // before the let*
+    bool zeroOrOne;  // likewise
+};
+struct Scope {
+    Dictionary declarations;
+    std::vector<Shadowed> shadowed;  // each variable the let* declares
+};
+}
+
+static void enterScope(Scope &scope)
+{
+    scope.declarations = declarationDict;
+    scope.shadowed.clear();
 }
 
-string DeclarationsNode::declarationsHelper(string declarationsHERA, HaverfordCS::list<ExprNode *> declarations, ContextInfo context) const {
-    if (empty(declarations)) {
-        return declarationsHERA;
+// note that the let* of "scope" declares "variable"
+static void shadow(Scope &scope, SymbolID variable)
+{
+    bool known = std::size_t(variable) < variableTypes.size();
+    scope.shadowed.push_back({ variable, known ? variableTypes[variable] : NO_TYPE, known && zeroOrOneVariables[variable] });
+}
+
+static void leaveScope(const Scope &scope)
+{
+    declarationDict = scope.declarations;
+    for (auto i = scope.shadowed.rbegin(); i != scope.shadowed.rend(); ++i) {
+        variableTypes[i->variable] = i->type;
+        zeroOrOneVariables[i->variable] = i->zeroOrOne;
     }
-    return declarationsHelper(declarationsHERA += first(declarations)->generateHERA(context), rest(declarations),
-                              context);
 }
 
-string DeclarationNode::generateHERA(const ContextInfo &context) const
+void LetNode::generateHERA(const ContextInfo &context, HERACode &code) const
 {
-    auto literal = expr;
-    string value;
-    if (declType == "IntLiteralNode") {
-        *literal = intLiteral;
-        value = to_string(intLiteral.getValue());
+    trace << "Entered LetNode::generateHERA" << endl;
+    ContextInfo declarationsContext = context;
+    ContextInfo expressionsContext = context;
+
+    Scope scope;
+    enterScope(scope);
+    if (declarations.kind() != DECLARATIONS_NODE) {
+        throw "compiler incomplete/inconsistent: a let* without declarations";
     }
-    else if (declType == "BoolLiteralNode") {
-        *literal = boolLiteral;
-        value = boolLiteral.getValue();
+    for (ExprHandle declaration : static_cast<const DeclarationsNode *>(declarations.node())->getDeclarations()) {
+        if (declaration.kind() != DECLARATION_NODE) {
+            throw "compiler incomplete/inconsistent: declarations with something else in them";
+        }
+        shadow(scope, static_cast<const DeclarationNode *>(declaration.node())->getVariable());
     }
-    else if (declType == "definedVar") {
-        *literal = definedVar;
-        value = definedVar.getValue();
+    declarations.generateHERA(declarationsContext, code);
+    for (std::size_t i = 0; i < expressions.size(); i++) {
+        if (i > 0) expressionsContext = expressionsContext.evalThisAfter();  // (see letExpressionNeed)
+        expressions[i].generateHERA(expressionsContext, code);
     }
+    leaveScope(scope);
+}
 
-    trace << "Entered DeclarationNode::generateHERA for declaration " + variable.getValue() + ((declType == "ExprNode")? " = expression" : " = " +
-    value) << endl;
+void DeclarationsNode::generateHERA(const ContextInfo &context, HERACode &code) const
+{
+    trace << "Entered DeclarationsNode::generateHERA" << endl;
 
-    if (declType == "definedVar") {
-        value = to_string(declarationDict.lookup(value));
+    ContextInfo labelContext = ContextInfo();
+
+    for (ExprHandle declaration : declarations) {
+        declaration.generateHERA(context, code);
     }
+}
 
+// the trace for a declaration, e.g. "... variable #3 = 42"
+static string declarationText(SymbolID variable, NodeKind valueKind, int value)
+{
+    return "Entered DeclarationNode::generateHERA for declaration of variable #" + to_string(variable) +
+           ((valueKind == INT_LITERAL_NODE || valueKind == BOOL_LITERAL_NODE)? " = " + to_string(value) :
+            (valueKind == VAR_USE_NODE)? " = variable #" + to_string(value) : " = expression");
+}
+
+// declare the variable, whose value has the given type (and is or isn't sure to be 0 or 1),
+//   at the next offset from the FP, and give that offset
+static int declare(SymbolID variable, Type type, bool zeroOrOne)
+{
     FPoffset += 1;
 
-    declarationDict.add(variable.getValue(), FPoffset);
+    declarationDict.add(variable, FPoffset);
+    if (variableTypes.size() <= std::size_t(variable)) {
+        variableTypes.resize(variable + 1, NO_TYPE);
+        zeroOrOneVariables.resize(variable + 1, false);
+    }
+    variableTypes[variable] = type;
+    zeroOrOneVariables[variable] = zeroOrOne;
+    return FPoffset;
+}
+
+// the code to store a declared variable's value
+static void storeHERA(const ContextInfo &context, int offset, HERACode &code)
+{
+    code.store(context.getRegNumber(), offset, FP);
+}
+
+void DeclarationNode::generateHERA(const ContextInfo &context, HERACode &code) const
+{
+    trace << declarationText(variable, value.kind(), value.isImmediate() ? value.value() : 0) << endl;
+
+    // the value is worked out (and its types checked) before the variable is declared,
+    //   so a variable of the same name in it is the one from before, e.g. in [z (>= z 100)]
+    Type type = resolve(typeOf(value));
+    bool zeroOrOne = isZeroOrOne(value);
+    value.generateHERA(context, code);
+    storeHERA(context, declare(variable, type, zeroOrOne), code);
+}
+
+
+// The FlatAST version:
+//   rather than calling itself for each child, this keeps a FlatFrame for each node
+//   it's inside of, and adds each node's code to the end of "code" when it's done with the node's children
+//   (each node's code comes after its children's, in the methods above, too, except that an if's
+//   also goes between them; see betweenFlatChildren).
+// It makes the ContextInfos (whose labels come from "random") in the same order as those methods,
+//   so the code is the same as for the same program as a tree.
+
+namespace {
+struct FlatFrame {
+    FlatAST::Index node;
+    FlatAST::IndexList children;
+    std::size_t next = 0;               // the next child to generate code for
+    std::vector<ContextInfo> contexts;  // [0] is the node's own; the rest depend on the kind (see enterFlatNode)
+    bool branch = false;                // for a comparison, whether it's an if's condition (see comparisonBranchHERA)
+    bool rightFirst = false;            // for arithmetic or a comparison, whether its children are done right to left
+    bool select = false;                // for an if, whether it's a simple select (see isSimpleSelect)
+    Scope scope;                        // for a let*
+};
+}
+
+static Immediate flatImmediate(const FlatAST &program, FlatAST::Index leaf)
+{
+    return Immediate{ program.kind(leaf), program.payload(leaf) };
+}
+
+// isZeroOrOne and isSimpleSelect, for entries of a FlatAST
+static bool isZeroOrOne(const FlatAST &program, FlatAST::Index e)
+{
+    if (program.isLeaf(e)) return isZeroOrOne(flatImmediate(program, e));
+    if (program.kind(e) == COMPARISON_NODE) return true;
+    if (program.kind(e) != IF_NODE) return false;
+    FlatAST::IndexList children = program.children(e);
+    return program.isLeaf(children[1]) && program.isLeaf(children[2]) &&
+           isZeroOrOne(flatImmediate(program, children[1])) && isZeroOrOne(flatImmediate(program, children[2]));
+}
+
+static bool isSimpleSelect(const FlatAST &program, FlatAST::Index condition, FlatAST::Index expriftrue, FlatAST::Index expriffalse,
+                           const ContextInfo &context)
+{
+    return program.isLeaf(expriftrue) && program.isLeaf(expriffalse) && program.kind(condition) != COMPARISON_NODE &&
+           isZeroOrOne(program, condition) && context.getRegNumber() > 2;
+}
+
+// start generating code for a node that isn't a leaf, pushing its FlatFrame
+static void enterFlatNode(const FlatAST &program, const std::vector<InferredType> &types,
+                          const std::vector<RegisterNeed> &needs, FlatAST::Index node, const ContextInfo &context, std::vector<FlatFrame> &stack, HERACode &code)
+{
+    // (an if's condition is its first child, and "next" has already moved past it)
+    bool condition = !stack.empty() && program.kind(stack.back().node) == IF_NODE && stack.back().next == 1;
+    ContextInfo elseLabelContext = condition ? stack.back().contexts[1] : context;
+    stack.push_back(FlatFrame());
+    FlatFrame &frame = stack.back();
+    frame.node = node;
+    frame.children = program.children(node);
+    frame.contexts.push_back(context);
+    NodeKind kind = program.kind(node);
+    FlatAST::IndexList &children = frame.children;
+    trace << "Entered flat " << nodeKindName(kind) << " #" << node << endl;
+
+    switch (kind) {
+        case ARITHMETIC_NODE:  // contexts are: own, the operand done second's
+            if (children.size() != 2) {
+                throw "compiler incomplete/inconsistent: generateHERA not implemented for non-binary arithmetic";
+            }
+            checkIntegerOperands(types[children[0]], types[children[1]], 99, "cannot perform arithmetic operations on non-integers");
+            frame.contexts.push_back(context.evalThisAfter());
+            frame.rightFirst = evaluateRightFirst(needs[children[0]], needs[children[1]], context.registersLeft());
+            if (frame.rightFirst) std::swap(children[0], children[1]);
+            break;
+        case COMPARISON_NODE:  // own, the operand done second's, end label (or, for an if's condition, the if's else label)
+            checkIntegerOperands(types[children[0]], types[children[1]], 98, "cannot perform comparison operations on non-integers");
+            frame.contexts.push_back(context.evalThisAfter());
+            frame.branch = condition;
+            frame.contexts.push_back(condition ? elseLabelContext : ContextInfo());
+            frame.rightFirst = evaluateRightFirst(needs[children[0]], needs[children[1]], context.registersLeft());
+            if (frame.rightFirst) std::swap(children[0], children[1]);
+            break;
+        case IF_NODE:  // own (for all three children), else label, end label, and for a simple select, its two more
+            checkBranchTypes(types[children[1]], types[children[2]]);
+            frame.contexts.push_back(ContextInfo());
+            frame.contexts.push_back(ContextInfo());
+            if (isSimpleSelect(program, children[0], children[1], children[2], context)) {
+                frame.select = true;
+                frame.contexts.push_back(context.evalThisAfter());
+                frame.contexts.push_back(frame.contexts[3].evalThisAfter());
+                FlatAST::IndexList condition;
+                condition.push_back(children[0]);
+                frame.children = condition;  // (the branches are done by selectHERA, in exitFlatNode)
+            }
+            break;
+        case LET_NODE:  // own, the next expression's
+            frame.contexts.push_back(context);
+            if (program.kind(children[0]) != DECLARATIONS_NODE) {
+                throw "compiler incomplete/inconsistent: a let* without declarations";
+            }
+            enterScope(frame.scope);
+            for (FlatAST::Index declaration : program.children(children[0])) {
+                if (program.kind(declaration) != DECLARATION_NODE) {
+                    throw "compiler incomplete/inconsistent: declarations with something else in them";
+                }
+                shadow(frame.scope, program.payload(declaration));
+            }
+            break;
+        case DECLARATIONS_NODE:
+            ContextInfo();  // (the label isn't used, but this keeps the same labels as the tree version)
+            break;
+        case DECLARATION_NODE: {
+            FlatAST::Index value = children[0];
+            bool immediate = program.isLeaf(value);
+            trace << declarationText(program.payload(node), program.kind(value), immediate ? program.payload(value) : 0) << endl;
+            if (immediate) {
+                immediateHERA(program.kind(value), program.payload(value), context, code);
+                frame.next = 1;  // that's the only child
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
 
-    return ((declType == "ExprNode")? literal->generateHERA(context) :
-           (declType == "definedVar")? "LOAD(" + context.getReg() + ", " + value + ", FP)\n" :
-           "SET(" + context.getReg() + ", " + value + ")\n") +
-           "STORE(" + context.getReg() + ", " + std::to_string(FPoffset) + ", FP)\n";
+// the context for the next child of the top FlatFrame
+static ContextInfo nextChildContext(const FlatAST &program, FlatFrame &frame)
+{
+    std::vector<ContextInfo> &contexts = frame.contexts;
+    switch (program.kind(frame.node)) {
+        case ARITHMETIC_NODE:
+        case COMPARISON_NODE:
+            return contexts[frame.next == 0 ? 0 : 1];
+        case LET_NODE:
+            if (frame.next == 0) {
+                return contexts[0];  // the declarations
+            } else {
+                if (frame.next > 1) contexts[1] = contexts[1].evalThisAfter();
+                return contexts[1];
+            }
+        default:
+            return contexts[0];
+    }
 }
 
+// the code before the top FlatFrame's next child, if it isn't the first
+static void betweenFlatChildren(const FlatAST &program, const FlatFrame &frame, HERACode &code)
+{
+    const std::vector<ContextInfo> &contexts = frame.contexts;
+    if (program.kind(frame.node) == IF_NODE) {
+        if (frame.next == 1) {
+            if (program.kind(frame.children[0]) != COMPARISON_NODE) ifConditionHERA(contexts[0], contexts[1], code);
+        } else {
+            ifElseHERA(contexts[1], contexts[2], code);
+        }
+    }
+}
 
+// the code after all the children of the top FlatFrame
+static void exitFlatNode(const FlatAST &program, const std::vector<InferredType> &types, const FlatFrame &frame,
+                         HERACode &code)
+{
+    const std::vector<ContextInfo> &contexts = frame.contexts;
+    const ContextInfo &lhsContext = contexts[frame.rightFirst ? 1 : 0], &rhsContext = contexts[frame.rightFirst ? 0 : 1];
+    int payload = program.payload(frame.node);
+    switch (program.kind(frame.node)) {
+        case ARITHMETIC_NODE:
+            arithmeticHERA(Operator(payload), contexts[0], lhsContext, rhsContext, code);
+            break;
+        case COMPARISON_NODE:
+            if (frame.branch) {
+                comparisonBranchHERA(Operator(payload), lhsContext, rhsContext, contexts[2], code);
+            } else {
+                comparisonValueHERA(Operator(payload), contexts[0], lhsContext, rhsContext, contexts[2], code);
+            }
+            break;
+        case CALL_NODE:
+            callHERA(program.name(payload), !frame.children.empty(), contexts[0], code);
+            break;
+        case IF_NODE:
+            if (frame.select) {
+                FlatAST::IndexList children = program.children(frame.node);
+                selectHERA(flatImmediate(program, children[1]), flatImmediate(program, children[2]),
+                           contexts[0], contexts[3], contexts[4], contexts[1], contexts[2], code);
+            } else {
+                ifEndHERA(contexts[2], code);
+            }
+            break;
+        case DECLARATION_NODE:
+            storeHERA(contexts[0], declare(program.payload(frame.node), resolve(types[frame.children[0]]),
+                                           isZeroOrOne(program, frame.children[0])), code);  // (after its value, as above)
+            break;
+        case LET_NODE:
+            leaveScope(frame.scope);
+            break;
+        default:
+            break;
+    }
+}
 
+HERACode generateHERACode(const FlatAST &program, Diagnostics &problems)
+{
+    declarationDict = Dictionary();  // start fresh for each program
+    FPoffset = -1;
+    variableTypes.clear();
+    zeroOrOneVariables.clear();
+    diagnostics = &problems;
+    std::vector<InferredType> types = inferTypes(program);
+    std::vector<RegisterNeed> needs = registerNeeds(program);
+
+    HERACode code;
+    code.cbon();
+    std::vector<FlatFrame> stack;
+    FlatAST::Index root = program.root();
+    if (program.isLeaf(root)) {
+        immediateHERA(program.kind(root), program.payload(root), ContextInfo(), code);
+        return code;
+    }
+    enterFlatNode(program, types, needs, root, ContextInfo(), stack, code);
+    while (!stack.empty()) {
+        FlatFrame &frame = stack.back();
+        if (frame.next < frame.children.size()) {
+            FlatAST::Index child = frame.children[frame.next];
+            if (frame.next > 0) betweenFlatChildren(program, frame, code);
+            ContextInfo childContext = nextChildContext(program, frame);
+            frame.next++;
+            if (program.isLeaf(child)) {
+                immediateHERA(program.kind(child), program.payload(child), childContext, code);
+            } else {
+                enterFlatNode(program, types, needs, child, childContext, stack, code);  // (which may move "frame")
+            }
+        } else {
+            exitFlatNode(program, types, frame, code);
+            stack.pop_back();
+        }
+    }
+    return code;
+}
 
+std::string generateFullHERA(const FlatAST &program, Diagnostics &problems)
+{
+    return finishedText(generateHERACode(program, problems));
+}
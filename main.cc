@@ -6,19 +6,60 @@
  *   Debug/Compiler-C++ < tests/01-multiply.hrk | tee Compiler.out
  * and then run the HERA program with the command
  *   HERA-C-Run Compiler.out
+ *
+ * The program can also be named on the command line, in which case it is memory-mapped
+ *   rather than read through standard input, e.g.
+ *   Debug/Compiler-C++ tests/01-multiply.hrk
+ * Naming several programs compiles them all at once, each in its own thread.
+ * To compile many programs in one run, separate them with <EOF> and use
+ *   Debug/Compiler-C++ batch programs.txt     (or, with no file name, standard input)
+ *   which writes each program's code to standard output, after a line like
+ *   // program 3: 42 bytes
+ *   giving the number of bytes of code that follow (0 if it couldn't be compiled).
+ *   A program with errors doesn't stop the batch: its errors go to standard error
+ *   and the compiler carries on with the next program.
+ * To limit the memory used for each program's tree or FlatAST (e.g. for a long-running batch), set
+ *   HAVERRACKET_AST_BUDGET to a number of bytes; a program that needs more isn't compiled.
+ * Setting HAVERRACKET_FLAT_AST=#t parses each program into a FlatAST (see FlatAST.h)
+ *   rather than a tree of nodes, and generates the code from that.
+ * Setting HAVERRACKET_FOLD_CONSTANTS=#f leaves constant expressions (e.g. (+ 3 4)) to be worked out
+ *   when the program runs, rather than by the compiler (see ConstantFolding.h).
+ * Setting HAVERRACKET_PEEPHOLE=#f leaves out the peephole optimizer (see Peephole.h),
+ *   e.g. to see the code just as it was generated.
+ * Setting HAVERRACKET_TAKEN_BRANCH_CYCLES to a number of cycles tells the cost model (see CostModel.h)
+ *   how long a taken branch takes on the HERA the code is for (2 if it isn't set), which is what decides
+ *   whether e.g. a comparison's 0 or 1 is made with branches or without; 1 makes it always use branches.
+ * To parse a program once and compile it several times (e.g. with different options), use
+ *   Debug/Compiler-C++ saveAST tests/01-multiply.hrk 01-multiply.hast
+ *   Debug/Compiler-C++ loadAST 01-multiply.hast
+ *   where the second command maps the saved AST into memory and generates code from it directly.
+ * The scanner's speed on a (large) file can be checked with
+ *   Debug/Compiler-C++ benchmarkScanner big-program.hrk
  */
 
 #include <iostream>
 #include <cstdlib>
+#include <chrono>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include "scannerDemo.h"
+#include "scanner.h"
 #include "parser.h"
+#include "TokenBuffer.h"
+#include "FlatAST.h"
+#include "NodeFactory.h"
+#include "PassManager.h"
+#include "TypeInference.h"
+#include "ConstantFolding.h"
 #include "ContextInfo.h"
-#include "hc_list_helpers.h" // ez_list
 
 using std::cout;
 using std::cerr;
 using std::endl;
 using std::string;
+using std::string_view;
 
 #include "streams.h"
 #include "Dictionary.h"
@@ -42,24 +83,109 @@ using std::string;
 #endif
 
 #include <fstream>  /* needed for ofstream below */
-std::ofstream _HaverRacket_trace(TRACE_OUTPUT_HERE);
-std::ostream &trace  = _HaverRacket_trace;
-std::ofstream _HaverRacket_prompt(PROMPT_OUTPUT_HERE);
-std::ostream &prompt = _HaverRacket_prompt;
+// each thread gets its own streams (on the same files), so threads compiling at once don't share stream buffers
+thread_local std::ofstream _HaverRacket_trace(TRACE_OUTPUT_HERE);
+thread_local std::ostream &trace  = _HaverRacket_trace;
+thread_local std::ofstream _HaverRacket_prompt(PROMPT_OUTPUT_HERE);
+thread_local std::ostream &prompt = _HaverRacket_prompt;
 
 #if ! defined AbstractSyntaxTest
 #define AbstractSyntaxTest build_example1   /* this lets us use a different test easily with a special command line */
 #endif
 
-ParserResult AbstractSyntaxTest();
+ParserResult AbstractSyntaxTest(Arena &nodes);
+static int compileConcurrently(int numberOfFiles, char *fileNames[]);
+static int compileBatch(const char *fileName);
+static int saveAST(const char *sourceFile, const char *astFile);
+static int compileSavedAST(const char *astFile);
+
+// the most memory to use for each program's tree or FlatAST, from HAVERRACKET_AST_BUDGET, or 0 for no limit
+static std::size_t astBudget()
+{
+	const char *budget = getenv("HAVERRACKET_AST_BUDGET");
+	return budget ? std::strtoull(budget, nullptr, 10) : 0;
+}
+
+// whether to use a FlatAST rather than a tree, from HAVERRACKET_FLAT_AST
+static bool useFlatAST()
+{
+	const char *flat = getenv("HAVERRACKET_FLAT_AST");
+	return flat && flat == string("#t");
+}
+
+// whether to fold constants, from HAVERRACKET_FOLD_CONSTANTS
+static bool useConstantFolding()
+{
+	const char *fold = getenv("HAVERRACKET_FOLD_CONSTANTS");
+	return !fold || fold != string("#f");
+}
+
+// run the passes between parsing and code generation on a program's tree (see PassManager.h),
+//   giving back the tree to generate code from, with its types in "types"
+static ParserResult runPasses(ParserResult AST, NodeFactory &factory, TypeInference &types)
+{
+	PassManager passes(factory);
+	ConstantFolding folding(types);
+	passes.add(types);
+	if (useConstantFolding()) passes.add(folding);
+	return passes.run(AST);
+}
+
+// the same for a FlatAST, followed by code generation (which works out the FlatAST's types itself)
+static string flatHERA(const FlatAST &program, Diagnostics &problems)
+{
+	return useConstantFolding() ? generateFullHERA(foldConstants(program), problems) : generateFullHERA(program, problems);
+}
+
+// parse the next program from "lexer" and generate its code, if there weren't any syntax errors,
+//   using either "program" or "nodes" (see useFlatAST) for the tree
+static string compileProgram(Lexer &lexer, Diagnostics &diagnostics, Arena &nodes, FlatAST &program)
+{
+	if (useFlatAST()) {
+		program.clear();
+		Parser(lexer, diagnostics, program).matchStartSymbolAndEOF();
+		return diagnostics.any() ? "" : flatHERA(program, diagnostics);
+	}
+	NodeFactory factory(nodes);
+	TypeInference types;
+	ParserResult AST = Parser(lexer, diagnostics, factory).matchStartSymbolAndEOF();
+	return diagnostics.any() ? "" : generateFullHERA(runPasses(AST, factory, types), diagnostics, types);
+}
 
 int main(int numberOfCommandLineArguments, char *theCommandLineArguments[])
 {
 	try {
 		bool testScannerInstead = false;
+		const char *sourceFile = nullptr;  // if not given, read standard input
         if (numberOfCommandLineArguments == 2 && theCommandLineArguments[1] == string("testScannerInstead")) {
 			trace << "Testing Scanner instead." << endl;
 			testScannerInstead = true;
+		} else if (numberOfCommandLineArguments == 3 && theCommandLineArguments[1] == string("benchmarkScanner")) {
+			scannerBenchmark(theCommandLineArguments[2]);
+			return 0;
+		} else if (numberOfCommandLineArguments <= 3 && numberOfCommandLineArguments >= 2 &&
+		           theCommandLineArguments[1] == string("batch")) {
+			return compileBatch(numberOfCommandLineArguments == 3 ? theCommandLineArguments[2] : nullptr);
+		} else if (numberOfCommandLineArguments == 4 && theCommandLineArguments[1] == string("saveAST")) {
+			return saveAST(theCommandLineArguments[2], theCommandLineArguments[3]);
+		} else if (numberOfCommandLineArguments == 3 && theCommandLineArguments[1] == string("loadAST")) {
+			return compileSavedAST(theCommandLineArguments[2]);
+		} else if (numberOfCommandLineArguments == 2) {
+			sourceFile = theCommandLineArguments[1];
+		} else if (numberOfCommandLineArguments > 2) {
+			return compileConcurrently(numberOfCommandLineArguments-1, theCommandLineArguments+1);
+		}
+
+		// the MappedFile must last as long as we're scanning it, i.e., until we're done parsing
+		std::optional<MappedFile> source;
+		std::optional<Lexer> sourceLexer;
+		if (sourceFile) {
+			source.emplace(sourceFile);
+			if (!source->ok()) {
+				cerr << "can't read " << sourceFile << endl;
+				return 1;
+			}
+			sourceLexer.emplace(source->text());
 		}
 
 		if (testScannerInstead) {
@@ -70,12 +196,14 @@ int main(int numberOfCommandLineArguments, char *theCommandLineArguments[])
 			    getenv("HAVERRACKET_TEST_CODE_HERA") == string("#t"))
 			{
 				try {
-					ParserResult example1 = AbstractSyntaxTest();
+					Arena nodes;
+					ParserResult example1 = AbstractSyntaxTest(nodes);
 
 					trace << "confirming codegen basic functionality on test example1:" << endl;
-					string code = generateFullHERA(example1);
+					Diagnostics problems;
+					string code = generateFullHERA(example1, problems);
 					trace << code << endl;
-					delete example1;  // we're done with example1 now.
+					// we're done with example1 now, and it goes away with "nodes"
 
 				} catch (const char *message) {
 					cerr << "code generation confirmation test threw exception: " << message << endl;
@@ -86,18 +214,51 @@ int main(int numberOfCommandLineArguments, char *theCommandLineArguments[])
             trace << "Type in new input!" << endl;
 
             try {
-				ParserResult AST = matchStartSymbolAndEOF();
+				Diagnostics problems;
+				Arena nodes(astBudget());
+				NodeFactory factory(nodes);
+				TypeInference types;
+				FlatAST flat(astBudget());
+				bool flatAST = useFlatAST();
+				ParserResult AST;
+				if (sourceLexer) {
+					// lex everything first, so we can see how long each phase takes
+					using clock = std::chrono::steady_clock;
+					auto start = clock::now();
+					TokenBuffer tokens(*sourceLexer);
+					auto lexed = clock::now();
+					AST = flatAST ? Parser(tokens, problems, flat).matchStartSymbolAndEOF() :
+					                Parser(tokens, problems, factory).matchStartSymbolAndEOF();
+					std::chrono::duration<double> lexTime = lexed - start, parseTime = clock::now() - lexed;
+					trace << "Lexed " << tokens.size() << " tokens in " << lexTime.count() << " s, "
+					      << "parsed them in " << parseTime.count() << " s" << endl;
+				} else {
+					AST = flatAST ? Parser(flexLexer(), problems, flat).matchStartSymbolAndEOF() :
+					                Parser(flexLexer(), problems, factory).matchStartSymbolAndEOF();
+				}
+				if (flatAST) {
+					alloc_trace << "FlatAST: " << flat.size() << " entries" << endl;
+				} else {
+					traceNodeSizes();
+				}
+				if (problems.any()) {
+					return problems.firstExitCode();  // the same status the parser used to exit with
+				}
+				if (!flatAST) {
+					AST = runPasses(AST, factory, types);
+				}
 //				trace << "Completed Parsing, got AST: " << AST.toCode() << endl;
 				try {
                     trace << "\nNow generating code: " << endl;
-					trace << generateFullHERA(AST) << endl;
+					string code = flatAST ? flatHERA(flat, problems) : generateFullHERA(AST, problems, types);
+					if (problems.any()) {
+						return problems.firstExitCode();
+					}
+					trace << code << endl;
 				} catch (const char *message) {
 					cerr << "eval threw exception (typically an unhandled case): " << message << endl;
 					return 4;
 				}
-#if FREE_AST_VIA_DESTRUCTORS
-				delete AST;
-#endif
 			} catch (const char *message) {
 				cerr << "that's odd, parser threw exception: " << message << endl;
 				return 3;
@@ -112,21 +273,162 @@ int main(int numberOfCommandLineArguments, char *theCommandLineArguments[])
 }
 
 
-	    
 
-ParserResult build_example1()
+// Compile several files at once, one per thread, each with its own Lexer and Parser,
+//   then print their code in order
+static int compileConcurrently(int numberOfFiles, char *fileNames[])
+{
+	std::vector<string> code(numberOfFiles);
+	std::vector<string> problems(numberOfFiles);
+	std::vector<std::thread> workers;
+
+	for (int i = 0; i < numberOfFiles; i++) {
+		workers.emplace_back([i, fileNames, &code, &problems]() {
+			MappedFile source(fileNames[i]);
+			if (!source.ok()) {
+				problems[i] = "can't read file";
+				return;
+			}
+			try {
+				std::ostringstream messages;  // rather than cerr, so the threads' messages don't get mixed up
+				Diagnostics diagnostics(messages);
+				Arena nodes(astBudget());
+				FlatAST program(astBudget());
+				Lexer lexer(source.text());
+				code[i] = compileProgram(lexer, diagnostics, nodes, program);
+				problems[i] = messages.str();
+			} catch (const char *message) {
+				problems[i] = string(message) + "\n";
+			}
+		});
+	}
+
+	int result = 0;
+	for (int i = 0; i < numberOfFiles; i++) {
+		workers[i].join();
+		if (problems[i] != "") {
+			cerr << fileNames[i] << ": " << problems[i];
+			result = 4;
+		} else {
+			trace << "\n// " << fileNames[i] << code[i] << endl;
+		}
+	}
+	return result;
+}
+
+// Compile each of the <EOF>-separated programs in a file (or standard input),
+//   writing each one's code as a separate record (see the comment at the top of this file)
+static int compileBatch(const char *fileName)
+{
+	std::optional<MappedFile> source;
+	string input;
+	if (fileName) {
+		source.emplace(fileName);
+		if (!source->ok()) {
+			cerr << "can't read " << fileName << endl;
+			return 1;
+		}
+	} else {
+		std::ostringstream everything;
+		everything << std::cin.rdbuf();
+		input = everything.str();
+	}
+
+	Lexer lexer(source ? source->text() : string_view(input));
+	Arena nodes(astBudget());  // used again for each program, since we're done with each one's tree before the next
+	FlatAST program(astBudget());  // likewise
+	int result = 0;
+	int programNumber = 0;
+	do {
+		programNumber++;
+		string code;
+		std::ostringstream messages;
+		try {
+			Diagnostics diagnostics(messages);
+			code = compileProgram(lexer, diagnostics, nodes, program);
+			if (diagnostics.any()) {
+				cerr << "program " << programNumber << ":\n" << messages.str();
+				code = "";
+				if (result == 0) result = diagnostics.firstExitCode();
+			}
+		} catch (const char *message) {
+			cerr << "program " << programNumber << ": " << message << endl;
+			code = "";
+			result = 4;
+		}
+		nodes.release();
+		cout << "// program " << programNumber << ": " << code.length() << " bytes\n" << code;
+	} while (lexer.startNextProgram());
+
+	traceNodeSizes();  // for all the programs together
+	cout.flush();
+	return result;
+}
+
+// Parse a program into a FlatAST, and save that in a file (see FlatAST.h)
+static int saveAST(const char *sourceFile, const char *astFile)
+{
+	MappedFile source(sourceFile);
+	if (!source.ok()) {
+		cerr << "can't read " << sourceFile << endl;
+		return 1;
+	}
+	try {
+		Diagnostics problems;
+		FlatAST program(astBudget());
+		Lexer lexer(source.text());
+		Parser(lexer, problems, program).matchStartSymbolAndEOF();
+		if (problems.any()) {
+			return problems.firstExitCode();
+		}
+		if (!program.save(astFile, lexer.symbolTable())) {
+			cerr << "can't write " << astFile << endl;
+			return 1;
+		}
+	} catch (const char *message) {
+		cerr << "that's odd, parser threw exception: " << message << endl;
+		return 3;
+	}
+	return 0;
+}
+
+// Generate the code for a program saved by saveAST, without lexing or parsing it again
+static int compileSavedAST(const char *astFile)
+{
+	Diagnostics problems;
+	SymbolTable symbols;
+	FlatAST program;
+	if (!program.load(astFile, problems, symbols)) {
+		return problems.firstExitCode();
+	}
+	try {
+		trace << "\nNow generating code: " << endl;
+		string code = flatHERA(program, problems);
+		if (problems.any()) {
+			return problems.firstExitCode();
+		}
+		trace << code << endl;
+	} catch (const char *message) {
+		cerr << "eval threw exception (typically an unhandled case): " << message << endl;
+		return 4;
+	}
+	return 0;
+}
+
+ParserResult build_example1(Arena &nodes)
 {
-//	ExprNode *product = new ArithmeticNode("*", HaverfordCS::ez_list<ExprNode *>(new IntLiteralNode(3), new IntLiteralNode(7)));
-//    ExprNode *product = new ArithmeticNode("*", HaverfordCS::ez_list<ExprNode *>(new BoolLiteralNode("#t"), new BoolLiteralNode("#f")));
-    ExprNode *product = new IfNode(new ComparisonNode("<=", new IntLiteralNode(6), new IntLiteralNode(7)), new BoolLiteralNode("#t"), new
-    BoolLiteralNode("#f"));
+//	ExprNode *product = nodes.make<ArithmeticNode>(OP_TIMES, ChildList({ExprHandle::integer(3), ExprHandle::integer(7)}));
+//    ExprNode *product = nodes.make<ArithmeticNode>(OP_TIMES, ChildList({ExprHandle::boolean(true), ExprHandle::boolean(false)}));
+    ExprNode *product = nodes.make<IfNode>(nodes.make<ComparisonNode>(OP_LESS_EQUAL, ExprHandle::integer(6), ExprHandle::integer(7)),
+                                           ExprHandle::boolean(true), ExprHandle::boolean(false));
 
     return product;
 /*
-  NOTE that the starter files ExprNode classes do _not_ support the following due to memory allocation techniques,
-    though it might seem at first to work:
+  NOTE that since the nodes are in an Arena, and never deleted one by one, the following are now safe,
+    though they generate the code for "product" twice:
+  (the parser shares equal subtrees like this itself; see NodeFactory.h)
 */
-	// return new ArithmeticNode("+", HaverfordCS::ez_list<ExprNode *>(product, product));
-	// return new ComparisonNode("<=", product, product);
+	// return nodes.make<ArithmeticNode>(OP_PLUS, ChildList({product, product}));
+	// return nodes.make<ComparisonNode>(OP_LESS_EQUAL, product, product);
 }
 
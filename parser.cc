@@ -1,12 +1,12 @@
 #include <iostream>
 #include <cstdlib>  // for 'exit' function to abandon the program
-#include <hc_list_helpers.h>
+#include <array>
+#include <bitset>
+#include <logic.h>
 #include "parser.h"
 #include "scanner.h"
 
 using std::string;
-using HaverfordCS::list;
-using HaverfordCS::ez_list;
 using std::cout;
 using std::cerr;
 using std::endl;
@@ -22,7 +22,7 @@ using std::endl;
 // E? -> E E?
 // E? -> ""
 // E_IN_PARENS -> OP E E
-// E_IN_PARENS -> letstar E E E?
+// E_IN_PARENS -> letstar E E E?   // where the first E must be declarations, i.e. ( [ E_IN_BRACKETS ] E_IN_PARENS )
 // E_IN_PARENS -> [ E_IN_BRACKETS ] E_IN_PARENS
 // E_IN_PARENS -> ""
 // E_IN_PARENS -> EXIT
@@ -31,211 +31,509 @@ using std::endl;
 
 // E_IN_BRACKETS -> E E
 
-// OP --> +|-|*|<=|=|>= OP_COMPARE
+// OP --> +|-|*|<=|=|>=|<|>|!= OP_COMPARE
 
-// Declare all functions, so they can call each other in any order
-//  (note: "static" means it's restricted to this scope, e.g. this file
-static ParserResult matchE();
-static ParserResult matchEInParens();
-static string matchOp();
+// FIRST and FOLLOW sets for those,
+//  as bitsets indexed by kindOfToken (from scanner-regexp.h), so checking membership is one bit test
+typedef std::bitset<NUMBER_OF_TOKEN_KINDS> TokenSet;
 
+constexpr unsigned long long bits(std::initializer_list<kindOfToken> kinds)
+{
+	unsigned long long result = 0;
+	for (kindOfToken k : kinds) result |= 1ull << k;
+	return result;
+}
+static_assert(NUMBER_OF_TOKEN_KINDS <= 64, "a TokenSet is built from an unsigned long long");
 
-// FIRST and FOLLOW sets for those,
-//  built with lists rather than sets, for familiarity
-//  defined in terms of kindOfToken from scanner-regexp.h
-static list<kindOfToken> FIRST_OP  = ez_list(PLUS, MINUS, TIMES, OP_COMPARE);
-static list<kindOfToken> FIRST_EIP = FIRST_OP;
-static list<kindOfToken> FIRST_E   = ez_list(INT_LITERAL, BOOL_LITERAL, IDENTIFIER, LPAREN, LBRACKET);
-
-static list<kindOfToken> FOLLOW_OP  = FIRST_E;
-static list<kindOfToken> FOLLOW_EIP = ez_list(RPAREN);
-static list<kindOfToken> FOLLOW_E   = /* append(FOLLOW_EIP, FIRST_E) */
-		                              list<kindOfToken>(RPAREN, FIRST_E);
-	                                  /* Dave should put "append" into list_helpers */
+static constexpr TokenSet FIRST_OP  = TokenSet(bits({PLUS, MINUS, TIMES, OP_COMPARE}));
+static constexpr TokenSet FIRST_EIP = TokenSet(bits({PLUS, MINUS, TIMES, OP_COMPARE,
+                                                     LBRACKET, KW_IF, KW_LETSTAR, KW_EXIT, KW_GETINT}));
+static constexpr TokenSet FIRST_E   = TokenSet(bits({INT_LITERAL, BOOL_LITERAL, IDENTIFIER, LPAREN, LBRACKET}));
+
+static constexpr TokenSet FOLLOW_OP  = FIRST_E;
+static constexpr TokenSet FOLLOW_EIP = TokenSet(bits({RPAREN}));
+static constexpr TokenSet FOLLOW_E   = TokenSet(bits({RPAREN,  /* FOLLOW_EIP, and FIRST_E: */
+                                                     INT_LITERAL, BOOL_LITERAL, IDENTIFIER, LPAREN, LBRACKET}));
+
+// The parse table for E_IN_PARENS: which production to use, given the token after the "("
+//   (the other nonterminals are simple enough to choose with a switch or an "if")
+static constexpr std::array<Parser::Production, NUMBER_OF_TOKEN_KINDS> buildInParensTable()
+{
+	std::array<Parser::Production, NUMBER_OF_TOKEN_KINDS> table{};  // all NO_PRODUCTION
+	for (int k = 0; k < NUMBER_OF_TOKEN_KINDS; k++) {
+		if (FIRST_OP[k]) table[k] = Parser::OPERATION;
+	}
+	table[LBRACKET]   = Parser::DECLARATIONS;
+	table[KW_IF]      = Parser::IF;
+	table[KW_LETSTAR] = Parser::LETSTAR;
+	table[KW_EXIT]    = Parser::CALL;
+	table[KW_GETINT]  = Parser::CALL;
+	return table;
+}
+static constexpr std::array<Parser::Production, NUMBER_OF_TOKEN_KINDS> IN_PARENS_TABLE = buildInParensTable();
+
+Parser::Parser(Lexer *lexer, const TokenBuffer *allTokens, Diagnostics &diagnostics, NodeFactory *nodes, FlatAST *flat) :
+	diagnostics(diagnostics),
+	nodes(nodes),
+	flat(flat),
+	lexer(lexer),
+	tokens(allTokens ? allTokens : &ownTokens)
+{
+}
+
+Parser::Parser(Lexer &tokens, Diagnostics &diagnostics, NodeFactory &nodes) :
+	Parser(&tokens, nullptr, diagnostics, &nodes, nullptr)
+{
+}
+
+Parser::Parser(const TokenBuffer &allTokens, Diagnostics &diagnostics, NodeFactory &nodes) :
+	Parser(nullptr, &allTokens, diagnostics, &nodes, nullptr)
+{
+}
+
+Parser::Parser(Lexer &tokens, Diagnostics &diagnostics, FlatAST &program) :
+	Parser(&tokens, nullptr, diagnostics, nullptr, &program)
+{
+}
+
+Parser::Parser(const TokenBuffer &allTokens, Diagnostics &diagnostics, FlatAST &program) :
+	Parser(nullptr, &allTokens, diagnostics, nullptr, &program)
+{
+}
+
+// The token access functions:
+//   "position" is the index of the current token, and if that (or something we're looking ahead to)
+//   isn't in "tokens" yet, we get it from the Lexer (if we're doing that)
+
+bool Parser::tokenAvailable(std::size_t lookahead)
+{
+	while (lexer && tokens->size() <= position + lookahead) {
+		lexer->getNextToken();
+		if (lexer->tokenAvailable()) {
+			ownTokens.append(*lexer);
+		} else {
+			lexer = nullptr;  // that's all of them
+		}
+	}
+	return position + lookahead < tokens->size();
+}
+
+kindOfToken Parser::currentTokenKind(std::size_t lookahead)
+{
+	return tokenAvailable(lookahead) ? tokens->kind(position + lookahead) : END_OF_INPUT;
+}
+
+std::string_view Parser::currentTokenView()
+{
+	precondition(tokenAvailable());
+	return tokens->text(position);
+}
+
+void Parser::getNextToken()
+{
+	if (tokenAvailable()) position++;
+}
 
 // first, some helpful functions:
 
+// error:
+//    report a problem at the current token, and abandon whatever we were matching
+//    (see matchE and matchStartSymbolAndEOF for where we pick up again)
+void Parser::error(int exitCode, const std::string &message)
+{
+	diagnostics.report(exitCode, message);
+	throw ParseError();
+}
+
+// integerOutOfRange:
+//    report an integer literal that doesn't fit in an int (see INT_OUT_OF_RANGE in scanner-regexp.h),
+//    where an integer would otherwise do
+void Parser::integerOutOfRange()
+{
+	error(3, "Integer out of range (" + currentToken() + ") at token #" + std::to_string(tokenNumber()));
+}
+
+// the current token, for error messages (which may happen at the end of the input)
+std::string Parser::describeCurrentToken()
+{
+	return tokenAvailable() ? currentToken() : "end of input";
+}
+
+// resynchronize:
+//    after an error somewhere inside the parentheses that start at token index "open",
+//    skip ahead to just after the ")" that balances them, so we can carry on after that E;
+//    return false if the input runs out first
+bool Parser::resynchronize(std::size_t open)
+{
+	position = open;
+	int depth = 0;
+	while (tokenAvailable()) {
+		kindOfToken kind = currentTokenKind();
+		getNextToken();
+		if (kind == LPAREN) {
+			depth++;
+		} else if (kind == RPAREN && --depth == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 // mustGetNextToken:
 //    we call this when we need to get more input and we must find something there,
 //    i.e. when we want to move current_token along and end-of-input would be an error
-void mustGetNextToken()
+void Parser::mustGetNextToken()
 {
 	getNextToken();
 	if (!tokenAvailable()) {
-		cerr << "unexpected end of input at token #" << tokenNumber() << endl;
-		exit(5);
+		error(5, "unexpected end of input at token #" + std::to_string(tokenNumber()));
 	}
 }
 
 
 // currentTokenThenMove
 //   record currentToken (which must NOT be end-of-input), then move past it, return what it was
-static std::string currentTokenThenMove()
+std::string Parser::currentTokenThenMove()
 {
 	if (!tokenAvailable()) {
-		cerr << "unexpected end of input at token #" << tokenNumber() << endl;
-		exit(5);
+		error(5, "unexpected end of input at token #" + std::to_string(tokenNumber()));
 	}
 	std::string curr = currentToken();
 	getNextToken();
 	return curr;
 }
 
+// currentValueThenMove
+//   like currentTokenThenMove, but return the token's value (see Lexer::currentTokenValue)
+//   rather than a string copy of the token, e.g. the integer for an INT_LITERAL
+//   or the SymbolID for an IDENTIFIER
+int Parser::currentValueThenMove()
+{
+	if (!tokenAvailable()) {
+		error(5, "unexpected end of input at token #" + std::to_string(tokenNumber()));
+	}
+	int value = tokens->value(position);
+	getNextToken();
+	return value;
+}
+
 // confirmLiteral
 //   match a literal, assuming the token HAS been scanned already,
 //    i.e. that "currentToken" is _on_ the literal we wish to match
 //   leave "currentToken" on the very last token of the matched pattern ... this is not a "match" function
-static void confirmLiteral(string what)
+void Parser::confirmLiteral(std::string_view what)
 {
 	if (!tokenAvailable()) {
-		cerr << "unexpected end of input at token #" << tokenNumber() << endl;
-		exit(5);
+		error(5, "unexpected end of input at token #" + std::to_string(tokenNumber()));
+	}
+	if (currentTokenView() != what) {
+		error(2, "got " + currentToken() + " instead of " + std::string(what) + " at token #" + std::to_string(tokenNumber()));
 	}
-	if (currentToken() != what) {
-		cerr << "got " << currentToken() << " instead of " << what << " at token #" << tokenNumber() << endl;
-		exit(2);
-	}	
 }
 
 
+// add an integer, boolean, or variable use to "results", and to the FlatAST if we're building one
+void Parser::pushLeaf(ExprHandle leaf)
+{
+	results.push_back(leaf);
+	if (flat) flat->addLeaf(leaf.kind(), leaf.value());
+}
+
+// add a node to the end of the FlatAST, whose children are everything from entry "first" on;
+//   the result is just a placeholder in "results", so continueFrame can count children the same way for both
+ParserResult Parser::addFlatNode(NodeKind kind, int payload, FlatAST::Index first)
+{
+	flat->addNode(kind, payload, first);
+	return ExprHandle();
+}
+
+// the children of a Frame, in order: the ones in "results" from index "from" on
+static ChildList childList(const std::vector<ParserResult> &results, std::size_t from)
+{
+	return ChildList(results.data() + from, results.data() + results.size());
+}
+
 // match an "E", i.e, anything on the right hand side of any "E-->..." production
 //  assume the first token of the E has been scanned
 //   (i.e., assuming currentToken is the first token of the "E" we're matching)
 //  leave "currentToken" AFTER the very last token of the matched pattern
-static ParserResult matchE()
-{
-	trace << "Entering matchE, current token is " << currentToken() << endl;
-	if (currentTokenKind() == INT_LITERAL) {
-        return new IntLiteralNode(std::stoi(currentTokenThenMove()));
-    } else if (currentTokenKind() == BOOL_LITERAL) {
-        return new BoolLiteralNode(currentTokenThenMove());
-	} else if (currentTokenKind() == IDENTIFIER) {
-        return new VarUseNode(currentTokenThenMove());
-	} else if (currentTokenKind() == LPAREN) {	
-		confirmLiteral("(");
-		mustGetNextToken();
-		ParserResult it = matchEInParens();
-		trace << "After matchEInParens, back in matchE, current token is: " << currentToken() << endl;
-		// if that left off AFTER the end of the E_IN_PARENS, we still need a ")" in the E we're matching
-		confirmLiteral(")");
-		getNextToken();	 // we're AFTER the ) now
-		return it;
-	} else {				
-		std::cerr << "Illegal token (" << currentToken() << ") at token #" << tokenNumber() << endl;
-		exit(3);
-	}
-}
-
-// match an "E_IN_PARENS",
-//  assuming that the currentToken is at the start of the E_IN_PARENS, e.g. a "+"
-//  leave the currentToken AFTER the last part of what was matched,
-//  i.e. *on* the ")" that should come after the E_IN_PARENS
-static ParserResult matchEInParens() {
-	trace << "Entering matchEInParens, current token is " << currentToken() << endl;
-	if (find(currentTokenKind(), FIRST_OP)) {
-        bool its_a_comparison_op = (currentTokenKind() == OP_COMPARE);
-        string theOp = matchOp();
-        ParserResult firstChild = matchE();
-        ParserResult secondChild = matchE();
-        if (its_a_comparison_op) { // a comparison
-            return new ComparisonNode(theOp, firstChild, secondChild);
-        } else {
-            return new ArithmeticNode(theOp, ez_list(firstChild, secondChild));
-        }
-    } else if (currentTokenKind() == LBRACKET) {
-        list<ExprNode *> declarations = list<ExprNode *>();
-	    while (currentTokenKind() != RPAREN) {
-            mustGetNextToken();
-            declarations = list(matchEinBrackets(), declarations);
-            confirmLiteral("]");
-            mustGetNextToken();
-        }
-	    return new DeclarationsNode(reverse(declarations, list<ExprNode *>()));
-    } else if (currentTokenKind() == IDENTIFIER && currentToken() == "if") {
-	    mustGetNextToken();
-	    ParserResult condition = matchE();
-        ParserResult expriftrue = matchE();
-        ParserResult expriffalse = matchE();
-        return new IfNode(condition, expriftrue, expriffalse);
-    } else if (currentTokenKind() == IDENTIFIER && currentToken() == "letstar") {
-        mustGetNextToken();
-        ParserResult declarations = matchE();
-        list<ExprNode *> expressions = list<ExprNode *>();
-        while (currentToken() != ")") {
-            expressions = list(matchE(), expressions);
-        }
-	    return new LetNode(declarations, reverse(expressions, list<ExprNode *>()));
-    } else if (currentTokenKind() == IDENTIFIER && currentToken() == "exit") {
-		return new CallNode(currentTokenThenMove(), list<ParserResult>());
-	} else if (currentTokenKind() == IDENTIFIER && currentToken() == "getint") {
-		return new CallNode(currentTokenThenMove(), list<ParserResult>());
+//  if there's an error inside the parentheses of "( E_IN_PARENS )", skip to the balancing ")"
+//   and use a null ExprHandle in place of that E, so that we can carry on and find any other errors
+//
+//  Rather than calling itself for each nested E (which runs out of stack space for
+//   deeply nested programs), matchE keeps a Frame in "stack" for each "( E_IN_PARENS )"
+//   (or "[ E_IN_BRACKETS ]") that's been started but not finished;
+//   the trees for the Es matched so far are in "results", the top Frame's children at the end.
+ParserResult Parser::matchE()
+{
+	stack.clear();
+	results.clear();
+	bool needAnE = true;
+	for (;;) {
+		try {
+			if (needAnE) {
+				trace << "Entering matchE, current token is " << describeCurrentToken() << endl;
+				switch (currentTokenKind()) {
+					case INT_LITERAL:
+						pushLeaf(ExprHandle::integer(currentValueThenMove()));
+						break;
+					case BOOL_LITERAL:
+						pushLeaf(ExprHandle::boolean(currentValueThenMove()));
+						break;
+					case IDENTIFIER:
+						pushLeaf(ExprHandle::variable(currentValueThenMove()));
+						break;
+					case LPAREN:
+						startEInParens();
+						break;
+					case INT_OUT_OF_RANGE:
+						integerOutOfRange();
+					case END_OF_INPUT:
+						error(5, "unexpected end of input at token #" + std::to_string(tokenNumber()));
+					default:
+						error(3, "Illegal token (" + currentToken() + ") at token #" + std::to_string(tokenNumber()));
+				}
+			}
+			if (stack.empty()) {
+				return results.back();
+			}
+			needAnE = continueFrame();
+		} catch (const ParseError &) {
+			// pick up again after the innermost "( ... )" we're in, if any
+			while (!stack.empty() && stack.back().open == Frame::NOT_IN_PARENS) {
+				stack.pop_back();
+			}
+			if (stack.empty() || !resynchronize(stack.back().open)) {
+				results.clear();
+				throw;  // nothing to carry on with
+			}
+			results.resize(stack.back().firstResult);  // (their nodes go when the Arena is released)
+			if (flat) flat->truncate(stack.back().firstEntry);  // (and nothing goes in place of that E there)
+			stack.pop_back();
+			results.push_back(ExprHandle());  // in place of that E
+			if (stack.empty()) {
+				return ExprHandle();
+			}
+			needAnE = continueFrame();
+		}
+	}
+}
+
+// start an "( E_IN_PARENS )", with the current token on the "(",
+//  choosing the production from the token after it, and pushing a Frame for it;
+//  leave the current token after whatever continueFrame won't see (e.g. the operator)
+void Parser::startEInParens()
+{
+	stack.push_back(Frame());  // first, so that after an error, we skip to the end of these parentheses
+	Frame &frame = stack.back();
+	frame.open = position;
+	frame.firstResult = results.size();
+	if (flat) frame.firstEntry = flat->size();
+
+	mustGetNextToken();
+	trace << "Entering matchEInParens, current token is " << currentTokenView() << endl;
+	frame.production = IN_PARENS_TABLE[currentTokenKind()];
+	switch (frame.production) {
+		case OPERATION:
+			frame.comparison = (currentTokenKind() == OP_COMPARE);
+			frame.op = matchOp();
+			break;
+		case IF:
+		case LETSTAR:
+			mustGetNextToken();
+			break;
+		case CALL:
+			frame.callee = (currentTokenKind() == KW_EXIT) ? "exit" : "getint";
+			getNextToken();
+			break;
+		case DECLARATIONS:
+			break;  // continueFrame will go through the "[ ... ]"s
+		default:
+			error(3, "Illegal token (" + currentToken() + ") at token #" + std::to_string(tokenNumber()));
+	}
+}
+
+// whether the first child of a let*'s Frame is declarations (or was left out after an error, which was reported then)
+bool Parser::declarationsFirst(const Frame &frame) const
+{
+	if (flat) return flat->size() == frame.firstEntry || flat->kind(flat->size() - 1) == DECLARATIONS_NODE;
+	ExprHandle first = results[frame.firstResult];
+	return first.isNull() || first.kind() == DECLARATIONS_NODE;
+}
+
+// the top Frame has just been started, or has just gotten another E;
+//  return true if it needs another E, otherwise finish it, replacing its children with its tree
+bool Parser::continueFrame()
+{
+	Frame &frame = stack.back();
+	std::size_t children = results.size() - frame.firstResult;
+	ParserResult it;
+	switch (frame.production) {
+		case OPERATION:
+			if (children < 2) return true;
+			if (flat) {
+				it = addFlatNode(frame.comparison ? COMPARISON_NODE : ARITHMETIC_NODE, frame.op, frame.firstEntry);
+			} else if (frame.comparison) {
+				it = nodes->comparison(frame.op, results[frame.firstResult], results[frame.firstResult+1]);
+			} else {
+				it = nodes->arithmetic(frame.op, childList(results, frame.firstResult));
+			}
+			break;
+		case IF:
+			if (children < 3) return true;
+			it = flat ? addFlatNode(IF_NODE, 0, frame.firstEntry) :
+			            nodes->ifExpression(results[frame.firstResult], results[frame.firstResult+1], results[frame.firstResult+2]);
+			break;
+		case LETSTAR:
+			if (children == 1 && !declarationsFirst(frame)) {
+				error(2, "got something other than declarations after letstar, before token #" + std::to_string(tokenNumber()));
+			}
+			if (children == 0 || currentTokenKind() != RPAREN) return true;
+			it = flat ? addFlatNode(LET_NODE, 0, frame.firstEntry) :
+			            nodes->let(results[frame.firstResult], childList(results, frame.firstResult+1));
+			break;
+		case CALL:
+			it = flat ? addFlatNode(CALL_NODE, flat->addName(frame.callee), frame.firstEntry) :
+			            nodes->call(frame.callee, ChildList());
+			break;
+		case DECLARATIONS:
+			while (currentTokenKind() != RPAREN) {
+				if (startDeclaration()) return true;
+			}
+			it = flat ? addFlatNode(DECLARATIONS_NODE, 0, frame.firstEntry) :
+			            nodes->declarations(childList(results, frame.firstResult));
+			break;
+		case DECLARATION:  // the E in "[ identifier E ]"
+			it = flat ? addFlatNode(DECLARATION_NODE, frame.variable, frame.firstEntry) :
+			            nodes->declaration(frame.variable, results.back());
+			results.back() = it;
+			stack.pop_back();
+			confirmLiteral("]");
+			mustGetNextToken();
+			return false;
+		default:
+			throw "compiler incomplete/inconsistent: no Frame for this production";
+	}
+
+	// we're on the ")" at the end of the E_IN_PARENS
+	trace << "After matchEInParens, back in matchE, current token is: " << describeCurrentToken() << endl;
+	confirmLiteral(")");
+	getNextToken();	 // we're AFTER the ) now
+	results.resize(frame.firstResult);
+	results.push_back(it);
+	stack.pop_back();
+	return false;
+}
+
+// match "[ E_IN_BRACKETS ]", with the current token on the "[";
+//  for "[ identifier (...) ]", push a Frame and return true, since that needs an E,
+//  otherwise add the DeclarationNode to "results" and return false
+bool Parser::startDeclaration()
+{
+	confirmLiteral("[");
+	mustGetNextToken();
+	if (currentTokenKind() != IDENTIFIER) {
+		error(3, "Illegal token (" + currentToken() + ") at token #" + std::to_string(tokenNumber()));
+	}
+	SymbolID variable = currentValueThenMove();
+	ExprHandle value;
+	switch (currentTokenKind()) {
+		case IDENTIFIER:
+			value = ExprHandle::variable(currentValueThenMove());
+			break;
+		case INT_LITERAL:
+			value = ExprHandle::integer(currentValueThenMove());
+			break;
+		case BOOL_LITERAL:
+			value = ExprHandle::boolean(currentValueThenMove());
+			break;
+		case INT_OUT_OF_RANGE:
+			integerOutOfRange();
+		case LPAREN: {
+			Frame frame;
+			frame.production = DECLARATION;
+			frame.firstResult = results.size();
+			if (flat) frame.firstEntry = flat->size();
+			frame.variable = variable;
+			stack.push_back(frame);
+			return true;
+		}
+		default:
+			error(3, "Illegal token (" + describeCurrentToken() + ") at token #" + std::to_string(tokenNumber()));
+	}
+	if (flat) {
+		FlatAST::Index first = flat->addLeaf(value.kind(), value.value());
+		results.push_back(addFlatNode(DECLARATION_NODE, variable, first));
 	} else {
-		std::cerr << "Illegal token (" << currentToken() << ") at token #" << tokenNumber() << endl;
-		exit(3);
-	}
-}
-
-static ParserResult matchEinBrackets() {
-    if (currentTokenKind() == IDENTIFIER) {
-        VarUseNode variable = VarUseNode(currentTokenThenMove());
-        if (currentTokenKind() == IDENTIFIER) {
-            VarUseNode definedVar = VarUseNode(currentTokenThenMove());
-            return new DeclarationNode(variable, definedVar, "definedVar");
-        }
-        else if (currentTokenKind() == INT_LITERAL) {
-            IntLiteralNode literal = IntLiteralNode(stoi(currentTokenThenMove()));
-            return new DeclarationNode(variable, literal, "IntLiteralNode");
-        }
-        else if (currentTokenKind() == BOOL_LITERAL) {
-            BoolLiteralNode literal = BoolLiteralNode(currentTokenThenMove());
-            return new DeclarationNode(variable, literal, "BoolLiteralNode");
-        }
-        else if (currentTokenKind() == LPAREN) {
-            ParserResult expr = matchE();
-            return new DeclarationNode(variable, expr, "ExprNode");
-        }
-    }
-    std::cerr << "Illegal token (" << currentToken() << ") at token #" << tokenNumber() << endl;
-    exit(3);
+		results.push_back(nodes->declaration(variable, value));
+	}
+	confirmLiteral("]");
+	mustGetNextToken();
+	return false;
 }
 
 // match an operator, assuming that it is the currentToken
 //  leave the currentToken AFTER the last part of what was matched, i.e. unchanged
-static string matchOp()
+Operator Parser::matchOp()
 {
-	trace << "Entering matchOp, current token is " << currentToken() << endl;
-	// could do three cases here, but that's so tedious...
-	assert (find(currentTokenKind(), FIRST_OP));
-	return currentTokenThenMove();
+	trace << "Entering matchOp, current token is " << currentTokenView() << endl;
+	assert (FIRST_OP[currentTokenKind()]);
+	Operator op;
+	switch (currentTokenKind()) {
+		case PLUS:  op = OP_PLUS;  break;
+		case MINUS: op = OP_MINUS; break;
+		case TIMES: op = OP_TIMES; break;
+		default: {  // OP_COMPARE, which is "=", "!=", "<", "<=", ">", or ">="
+			std::string_view text = currentTokenView();
+			bool orEqual = text.size() == 2 && text[1] == '=';
+			op = (text[0] == '=') ? OP_EQUAL :
+			     (text[0] == '!') ? OP_NOT_EQUAL :
+			     (text[0] == '<') ? (orEqual ? OP_LESS_EQUAL : OP_LESS) : (orEqual ? OP_GREATER_EQUAL : OP_GREATER);
+		}
+	}
+	getNextToken();
+	return op;
 }
 
 
-ParserResult matchStartSymbolAndEOF()
+ParserResult Parser::matchStartSymbolAndEOF()
 {
-	getNextToken();  // this will be the first one
-	if (!tokenAvailable()) {
-		cerr << "Illegal end of input" << endl;
-		exit(2);
-	}
+	position = 0;  // start with the first token
+	ParserResult fullExpression;
+	try {
+		if (!tokenAvailable()) {
+			error(2, "Illegal end of input");
+		}
 
-	ParserResult fullExpression = matchE();  // "E" is our start symbol
+		fullExpression = matchE();  // "E" is our start symbol
 
-	// now make sure there isn't anything else!
-	getNextToken();
-	if (tokenAvailable()) {
-		cerr << "Warning: extra input after end: " << currentToken() << endl;
-		exit (1);
+		// now make sure there isn't anything else!
+		//   (matchE leaves us AFTER the E, so we're already on whatever follows it)
+		if (tokenAvailable()) {
+			error(1, "Warning: extra input after end: " + currentToken());
+		}
+	} catch (const ParseError &) {
+		// we couldn't carry on; skip the rest, so the Lexer is ready for any program after this one
+		while (tokenAvailable()) getNextToken();
+	} catch (const char *message) {
+		// e.g. the Arena ran out of its budget; give up on this program, the same way
+		diagnostics.report(3, string("parser gave up: ") + message);
+		while (tokenAvailable()) getNextToken();
 	}
 
-	return fullExpression;
+	return fullExpression;  // which the caller shouldn't use if there were any errors
 }
 
-list<ExprNode *> reverse(list<ExprNode *> list, ::list<ExprNode *> newList) {
-    if (empty(list)) {
-        return newList;
-    }
-    if (length(list) == 1) {
-        return ::list(first(list), newList);
-    }
-    return reverse(rest(list), ::list(first(list), newList));
-}
\ No newline at end of file
+// the old interface: exit if there's a problem, as the parser used to
+//   (the tree lasts until this thread ends)
+ParserResult matchStartSymbolAndEOF()
+{
+	static thread_local Arena nodes;
+	static thread_local NodeFactory factory(nodes);  // (destroyed before "nodes", since it was made after it)
+	Diagnostics diagnostics;
+	ParserResult result = Parser(flexLexer(), diagnostics, factory).matchStartSymbolAndEOF();
+	if (diagnostics.any()) {
+		exit(diagnostics.firstExitCode());
+	}
+	return result;
+}
@@ -2,17 +2,109 @@
 #define PARSER_H_
 
 
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "AST.h"
+#include "scanner.h"
+#include "TokenBuffer.h"
+#include "Diagnostics.h"
+#include "Arena.h"
+#include "NodeFactory.h"
+#include "FlatAST.h"
 
-// The typedef below makes the name "translatedResult"
-//  mean a "Tree" object from our Expr_Node type heirarchy.
-typedef ExprNode *ParserResult;
+// The typedef below makes the name "ParserResult"
+//  mean a tree from our Expr_Node type heirarchy (or an immediate leaf; see ExprHandle in AST.h).
+typedef ExprHandle ParserResult;
 
+// A Parser matches the tokens from one Lexer;
+//   all of its state is in the Parser and Lexer objects,
+//   so separate Parser/Lexer pairs can be used at the same time in separate threads.
+// The Parser walks through the tokens by index in a TokenBuffer, which is either
+//   filled from the Lexer as the Parser needs more tokens, or lexed completely beforehand.
+// Syntax errors are reported to "diagnostics"; the Parser then skips ahead and carries on,
+//   so one bad program doesn't stop the whole compiler.
+// The nodes of the tree are made by the NodeFactory "nodes", so each distinct subtree is only made once,
+//   and they last until its Arena is released (the same NodeFactory can then be used by later passes; see PassManager.h);
+//   or, given a FlatAST rather than a NodeFactory, the Parser adds the program's nodes to the end of that.
+class Parser {
+public:
+	Parser(Lexer &tokens, Diagnostics &diagnostics, NodeFactory &nodes);                 // get tokens from the Lexer as they're needed
+	Parser(const TokenBuffer &allTokens, Diagnostics &diagnostics, NodeFactory &nodes);  // use tokens that were all lexed first
+	Parser(Lexer &tokens, Diagnostics &diagnostics, FlatAST &program);
+	Parser(const TokenBuffer &allTokens, Diagnostics &diagnostics, FlatAST &program);
+
+	// match a whole program, up to end-of-input or <EOF>;
+	//   if any errors were reported, the result is incomplete (or null) and shouldn't be used
+	//   (when building a FlatAST, the program is there, and the result shouldn't be used)
+	ParserResult matchStartSymbolAndEOF();
+
+	// C++ Usage Note: a copy's "tokens" would point to the original's "ownTokens", so don't allow copies
+	Parser(const Parser &) = delete;
+	Parser &operator=(const Parser &) = delete;
+
+	// the productions for E_IN_PARENS (see parser.cc), plus the E in "[ identifier E ]"
+	enum Production { NO_PRODUCTION, OPERATION, DECLARATIONS, IF, LETSTAR, CALL, DECLARATION };
+private:
+	// something matchE has started but not finished (see matchE for how these are used)
+	struct Frame {
+		static const std::size_t NOT_IN_PARENS = SIZE_MAX;
+		Production production = NO_PRODUCTION;
+		std::size_t open = NOT_IN_PARENS;  // index of the "(" token, to skip ahead after an error
+		std::size_t firstResult = 0;       // index in "results" of the first child
+		FlatAST::Index firstEntry = 0;     // index in "flat" of the first entry of its subtree, if we're building one
+		Operator op = OP_PLUS;             // for OPERATION
+		bool comparison = false;
+		SymbolID variable = -1;            // for DECLARATION
+		const char *callee = nullptr;      // for CALL
+	};
+
+	Parser(Lexer *lexer, const TokenBuffer *allTokens, Diagnostics &diagnostics, NodeFactory *nodes, FlatAST *flat);
+
+	ParserResult matchE();
+	void startEInParens();
+	bool continueFrame();
+	bool declarationsFirst(const Frame &frame) const;
+	bool startDeclaration();
+	Operator matchOp();
+	void pushLeaf(ExprHandle leaf);
+	ParserResult addFlatNode(NodeKind kind, int payload, FlatAST::Index first);
+
+	void mustGetNextToken();
+	std::string currentTokenThenMove();
+	int currentValueThenMove();
+	void confirmLiteral(std::string_view what);
+
+	struct ParseError {};  // thrown by "error", to get back to where we can carry on
+	[[noreturn]] void error(int exitCode, const std::string &message);
+	[[noreturn]] void integerOutOfRange();
+	std::string describeCurrentToken();
+	bool resynchronize(std::size_t open);
+
+	// like the Lexer methods of the same names, but working through "tokens";
+	//   "lookahead" lets us see the kind of token that many places after the current one
+	bool tokenAvailable(std::size_t lookahead = 0);
+	kindOfToken currentTokenKind(std::size_t lookahead = 0);
+	std::string_view currentTokenView();
+	std::string currentToken() { return std::string(currentTokenView()); }
+	int  tokenNumber() const { return position + 1; }
+	void getNextToken();
+
+	Diagnostics &diagnostics;
+	NodeFactory *nodes;  // what makes the tree's nodes ...
+	FlatAST *flat;       // ... or, if there isn't one, where to put the program instead
+	Lexer *lexer;         // where to get more tokens, or nullptr if there are no more
+	TokenBuffer ownTokens;
+	const TokenBuffer *tokens;  // either &ownTokens, or the ones lexed beforehand
+	std::size_t position = 0;   // index of the current token in "tokens"
+
+	std::vector<Frame> stack;          // for matchE
+	std::vector<ParserResult> results;
+};
+
+// parse whatever the flex Lexer is scanning (standard input, by default),
+//   exiting (with the status of the first error) if there are any syntax errors
 ParserResult matchStartSymbolAndEOF();
-static ParserResult matchE();
-static ParserResult matchEinParens();
-static ParserResult matchEinBrackets();
-static std::string matchOp();
-list<ExprNode *> reverse(list<ExprNode *> list, ::list<ExprNode *> newList);
 
 #endif /*PARSER_H_*/
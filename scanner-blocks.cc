@@ -0,0 +1,195 @@
+#include "scanner-blocks.h"
+
+// to build without the SIMD versions, compile with -DUSE_SIMD_SCANNING=0
+#if ! defined USE_SIMD_SCANNING
+#if defined __SSE2__
+#define USE_SIMD_SCANNING 1
+#else
+#define USE_SIMD_SCANNING 0
+#endif
+#endif
+
+#if USE_SIMD_SCANNING
+#include <immintrin.h>
+#endif
+
+using std::size_t;
+
+// The character classes, one character at a time (these are also the "scalar fallback")
+static inline bool isBlank(char c)          { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+static inline bool isDigit(char c)          { return c >= '0' && c <= '9'; }
+static inline bool isIdentifierRest(char c) { return (c >= 'a' && c <= 'z') || isDigit(c) || c == '_'; }
+
+
+#if USE_SIMD_SCANNING
+
+// The block versions build a bit mask with one bit per byte of the block, set for bytes IN the class;
+//   the first byte not in the class is then the lowest 0 bit, i.e., the lowest 1 bit of the complement.
+// Comparisons are signed, which is fine since all our classes are ASCII (bytes >= 128 are negative,
+//   so they fall outside every range below).
+//
+// C++ Usage Note: __attribute__((target("avx2"))) lets us use AVX2 instructions in just these functions,
+//   without requiring them for the whole program; we only call them if the CPU has them.
+
+#define IN_RANGE16(block, lo, hi) \
+	_mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8((lo)-1)), _mm_cmplt_epi8(block, _mm_set1_epi8((hi)+1)))
+#define IN_RANGE32(block, lo, hi) \
+	_mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8((lo)-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8((hi)+1), block))
+
+static inline unsigned blankMask16(__m128i b)
+{
+	__m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(b, _mm_set1_epi8('\t'))),
+	                             _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(b, _mm_set1_epi8('\r'))));
+	return _mm_movemask_epi8(blank);
+}
+__attribute__((target("avx2"))) static inline unsigned blankMask32(__m256i b)
+{
+	__m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(b, _mm256_set1_epi8('\t'))),
+	                                _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(b, _mm256_set1_epi8('\r'))));
+	return _mm256_movemask_epi8(blank);
+}
+
+static inline unsigned notNewlineMask16(__m128i b)
+{
+	return ~_mm_movemask_epi8(_mm_cmpeq_epi8(b, _mm_set1_epi8('\n'))) & 0xFFFF;
+}
+__attribute__((target("avx2"))) static inline unsigned notNewlineMask32(__m256i b)
+{
+	return ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, _mm256_set1_epi8('\n')));
+}
+
+static inline unsigned digitMask16(__m128i b)
+{
+	return _mm_movemask_epi8(IN_RANGE16(b, '0', '9'));
+}
+__attribute__((target("avx2"))) static inline unsigned digitMask32(__m256i b)
+{
+	return _mm256_movemask_epi8(IN_RANGE32(b, '0', '9'));
+}
+
+static inline unsigned identifierRestMask16(__m128i b)
+{
+	__m128i in = _mm_or_si128(_mm_or_si128(IN_RANGE16(b, 'a', 'z'), IN_RANGE16(b, '0', '9')),
+	                          _mm_cmpeq_epi8(b, _mm_set1_epi8('_')));
+	return _mm_movemask_epi8(in);
+}
+__attribute__((target("avx2"))) static inline unsigned identifierRestMask32(__m256i b)
+{
+	__m256i in = _mm256_or_si256(_mm256_or_si256(IN_RANGE32(b, 'a', 'z'), IN_RANGE32(b, '0', '9')),
+	                             _mm256_cmpeq_epi8(b, _mm256_set1_epi8('_')));
+	return _mm256_movemask_epi8(in);
+}
+
+// Skip whole blocks for as long as every byte is in the class, using the given mask functions;
+//   return where the scalar loop should take over (either in the middle of a block, or near "end")
+#define SKIP_BLOCKS_16(maskFunction)                                                       \
+	while (from + 16 <= end) {                                                             \
+		unsigned outside = ~maskFunction(_mm_loadu_si128((const __m128i *) (text + from))) & 0xFFFF; \
+		if (outside) return from + __builtin_ctz(outside);                                 \
+		from += 16;                                                                        \
+	}
+#define SKIP_BLOCKS_32(maskFunction)                                                       \
+	while (from + 32 <= end) {                                                             \
+		unsigned outside = ~maskFunction(_mm256_loadu_si256((const __m256i *) (text + from))); \
+		if (outside) return from + __builtin_ctz(outside);                                 \
+		from += 32;                                                                        \
+	}
+
+__attribute__((target("avx2"))) static size_t skipBlankBlocks32(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_32(blankMask32)
+	return from;
+}
+static size_t skipBlankBlocks16(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_16(blankMask16)
+	return from;
+}
+__attribute__((target("avx2"))) static size_t skipCommentBlocks32(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_32(notNewlineMask32)
+	return from;
+}
+static size_t skipCommentBlocks16(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_16(notNewlineMask16)
+	return from;
+}
+__attribute__((target("avx2"))) static size_t skipIdentifierBlocks32(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_32(identifierRestMask32)
+	return from;
+}
+static size_t skipIdentifierBlocks16(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_16(identifierRestMask16)
+	return from;
+}
+__attribute__((target("avx2"))) static size_t skipDigitBlocks32(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_32(digitMask32)
+	return from;
+}
+static size_t skipDigitBlocks16(const char *text, size_t from, size_t end)
+{
+	SKIP_BLOCKS_16(digitMask16)
+	return from;
+}
+
+int blockScanWidth = __builtin_cpu_supports("avx2") ? 32 : 16;
+
+#define SKIP_BLOCKS(name)                                                   \
+	if (blockScanWidth == 32)      from = name##32(text, from, end);        \
+	else if (blockScanWidth == 16) from = name##16(text, from, end);
+
+#else
+
+int blockScanWidth = 1;
+
+#define SKIP_BLOCKS(name)
+
+#endif
+
+
+// Most tokens and gaps are short, so each of these first looks at a few characters one at a time,
+//   and only switches to the block version (then finishes one at a time) for a long run,
+//   such as indentation, comments, or long names and numbers.
+static const size_t shortRun = 8;
+
+#define SKIP(inClass)                                                       \
+	size_t shortEnd = (end - from > shortRun) ? from + shortRun : end;      \
+	while (from < shortEnd && inClass(text[from])) from++;                  \
+	if (from < shortEnd || from == end) return from;
+
+size_t skipBlankSpace(const char *text, size_t from, size_t end)
+{
+	SKIP(isBlank)
+	SKIP_BLOCKS(skipBlankBlocks)
+	while (from < end && isBlank(text[from])) from++;
+	return from;
+}
+
+static inline bool isCommentText(char c) { return c != '\n'; }
+size_t skipCommentText(const char *text, size_t from, size_t end)
+{
+	SKIP(isCommentText)
+	SKIP_BLOCKS(skipCommentBlocks)
+	while (from < end && text[from] != '\n') from++;
+	return from;
+}
+
+size_t skipIdentifierRest(const char *text, size_t from, size_t end)
+{
+	SKIP(isIdentifierRest)
+	SKIP_BLOCKS(skipIdentifierBlocks)
+	while (from < end && isIdentifierRest(text[from])) from++;
+	return from;
+}
+
+size_t skipDigits(const char *text, size_t from, size_t end)
+{
+	SKIP(isDigit)
+	SKIP_BLOCKS(skipDigitBlocks)
+	while (from < end && isDigit(text[from])) from++;
+	return from;
+}
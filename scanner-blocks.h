@@ -0,0 +1,26 @@
+#ifndef SCANNER_BLOCKS_H_
+#define SCANNER_BLOCKS_H_
+
+#include <cstddef>
+
+/*
+ *  Helpers for the hand-written scanner (Lexer::scanText in scanner.cc) that skip over runs of
+ *    characters of one class, looking at 32 bytes at a time with AVX2 or 16 at a time with SSE2,
+ *    and one at a time for whatever's left over (or if neither is available).
+ *
+ *  Each takes the text, where to start, and where the text ends,
+ *    and returns the index of the first character at or after "from" that is NOT in the class
+ *    (or "end" if there isn't one).
+ *  None of them reads anything at or after "end".
+ */
+
+std::size_t skipBlankSpace(const char *text, std::size_t from, std::size_t end);      // ' ', '\t', '\n', '\r'
+std::size_t skipCommentText(const char *text, std::size_t from, std::size_t end);     // anything but '\n'
+std::size_t skipIdentifierRest(const char *text, std::size_t from, std::size_t end);  // [a-z0-9_]
+std::size_t skipDigits(const char *text, std::size_t from, std::size_t end);          // [0-9]
+
+// How many bytes at a time the functions above look at: 32, 16, or 1 (i.e., no SIMD);
+//   by default the widest this machine supports. Only change it when nothing is being scanned.
+extern int blockScanWidth;
+
+#endif /*SCANNER_BLOCKS_H_*/
@@ -5,6 +5,9 @@
 
 /* A lexical scanner generated by flex */
 
+/* The tables below were edited by hand for the <, > and != rules in scanner-regexp.l,
+   since flex wasn't at hand; build the update_scanner target where it is, to replace this file. */
+
 #define FLEX_SCANNER
 #define YY_FLEX_MAJOR_VERSION 2
 #define YY_FLEX_MINOR_VERSION 6
@@ -359,12 +362,12 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static const flex_int16_t yy_accept[33] =
+static const flex_int16_t yy_accept[37] =
     {   0,
         0,    0,   20,   18,    1,    2,    2,   18,    4,    5,
-       10,    8,    9,   15,    3,   18,   11,   18,   17,    6,
+       10,    8,    9,   15,    3,   12,   11,   13,   17,    6,
         7,   16,   15,    3,   12,    0,   13,   17,    0,    0,
-       14,    0
+       14,    0,    0,    0,   18,   11
     } ;
 
 static const YY_CHAR yy_ec[256] =
@@ -372,7 +375,7 @@ static const YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1,    1,    1,    1,    2,    3,
         1,    1,    4,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    2,    1,    1,    5,    1,    1,    1,    1,    6,
+        1,    2,   26,    1,    5,    1,    1,    1,    1,    6,
         7,    8,    9,    1,   10,    1,    1,   11,   11,   11,
        11,   11,   11,   11,   11,   11,   11,    1,   12,   13,
        14,   15,    1,    1,   16,   16,   16,   16,   17,   18,
@@ -399,30 +402,30 @@ static const YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static const YY_CHAR yy_meta[26] =
+static const YY_CHAR yy_meta[27] =
     {   0,
         1,    1,    2,    1,    1,    1,    1,    1,    1,    1,
         3,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    3,    3,    3,    3
+        1,    3,    3,    3,    3,    1
     } ;
 
-static const flex_int16_t yy_base[35] =
+static const flex_int16_t yy_base[37] =
     {   0,
-        0,    0,   40,   41,   41,   41,   41,    2,   41,   41,
+       68,    0,   40,   41,   41,   41,   41,    2,   41,   41,
        41,   41,   28,   27,    0,   14,   41,   23,    0,   41,
        41,   41,   25,    0,   41,   16,   41,    0,   15,   15,
-       41,   41,   31,   26
+       41,   41,   31,   26,   95,   41
     } ;
 
-static const flex_int16_t yy_def[35] =
+static const flex_int16_t yy_def[37] =
     {   0,
        32,    1,   32,   32,   32,   32,   32,   32,   32,   32,
        32,   32,   32,   32,   33,   32,   32,   32,   34,   32,
        32,   32,   32,   33,   32,   32,   32,   34,   32,   32,
-       32,    0,   32,   32
+       32,    0,   32,   32,   32,   32
     } ;
 
-static const flex_int16_t yy_nxt[67] =
+static const flex_int16_t yy_nxt[122] =
     {   0,
         4,    5,    6,    7,    8,    9,   10,   11,   12,   13,
        14,   15,   16,   17,   18,   19,   19,   19,   19,   20,
@@ -430,10 +433,17 @@ static const flex_int16_t yy_nxt[67] =
        26,   24,   30,   24,   29,   23,   27,   23,   23,   32,
         3,   32,   32,   32,   32,   32,   32,   32,   32,   32,
        32,   32,   32,   32,   32,   32,   32,   32,   32,   32,
-       32,   32,   32,   32,   32,   32
+       32,   32,   32,   32,   32,   32,   32,    3,    4,    5,
+        6,    7,    8,    9,   10,   11,   12,   13,   14,   15,
+       16,   17,   18,   19,   19,   19,   19,   20,   21,    4,
+       19,   19,   19,   35,    3,   32,   32,   32,   32,   32,
+
+       32,   32,   32,   32,   32,   32,   32,   32,   36,   32,
+       32,   32,   32,   32,   32,   32,   32,   32,   32,   32,
+       32
     } ;
 
-static const flex_int16_t yy_chk[67] =
+static const flex_int16_t yy_chk[122] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -441,7 +451,14 @@ static const flex_int16_t yy_chk[67] =
        16,   33,   29,   33,   26,   23,   18,   14,   13,    3,
        32,   32,   32,   32,   32,   32,   32,   32,   32,   32,
        32,   32,   32,   32,   32,   32,   32,   32,   32,   32,
-       32,   32,   32,   32,   32,   32
+       32,   32,   32,   32,   32,   32,   32,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,   35,   35,   35,   35,   35,   35,
+
+       35,   35,   35,   35,   35,   35,   35,   35,   35,   35,
+       35,   35,   35,   35,   35,   35,   35,   35,   35,   35,
+       35
     } ;
 
 static yy_state_type yy_last_accepting_state;
@@ -481,7 +498,7 @@ extern "C" int yywrap()
  return 1;
 }
 
-#line 484 "<stdout>"
+#line 501 "<stdout>"
 /* In this second section of the lex file (after the %}),
    we can define variables in terms of regular expressions.
    C-style comments (like this one) are also legal. */
@@ -490,7 +507,7 @@ extern "C" int yywrap()
    in terms of regular expressions and the variables above,
    and give the action (as C++ code) for each token.
    Comments are legal only inside the actions. */
-#line 493 "<stdout>"
+#line 510 "<stdout>"
 
 #define INITIAL 0
 
@@ -710,7 +727,7 @@ YY_DECL
 #line 38 "scanner-regexp.l"
 
 
-#line 713 "<stdout>"
+#line 730 "<stdout>"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -863,7 +880,7 @@ YY_RULE_SETUP
 #line 63 "scanner-regexp.l"
 ECHO;
 	YY_BREAK
-#line 866 "<stdout>"
+#line 883 "<stdout>"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -5,7 +5,14 @@ enum kindOfToken {
 	OP_COMPARE,
 	INT_LITERAL, BOOL_LITERAL,
 	IDENTIFIER, LBRACKET,
-	RBRACKET
+	RBRACKET,
+	// keywords: the rules below match these as IDENTIFIERs, and the Lexer (scanner.cc) then
+	//   recognizes them, so that the parser can tell them apart by kind rather than by comparing text
+	KW_IF, KW_LETSTAR, KW_EXIT, KW_GETINT,
+	// an INT_LITERAL too big (or too negative) for an int: the Lexer gives it this kind instead,
+	//   and the parser reports it
+	INT_OUT_OF_RANGE,
+	NUMBER_OF_TOKEN_KINDS  // not a kind of token; keep this last
 };
 
 void scannerError(); /// define in whatever uses the regexp-based scanner
@@ -1,6 +1,8 @@
 #include <iostream>
+#include <charconv> // for from_chars, to read an int straight out of a token
 #include <logic.h>
 #include "scanner.h"
+#include "scanner-blocks.h"
 
 #if ! defined USE_YYLEX
 #define USE_YYLEX 1  /* Use the stuff from scanner-regexp.l by default */
@@ -9,24 +11,89 @@
 using namespace std;
 
 int tokenCount = 0;  // not static because the .l file needs it too
-static bool endOfInput = false;
-static bool calledGetNextTokenAlready = false;
-static string current = "";
-static kindOfToken currentKind;
 
 // some things built into scanner-regexp.cc by the flex system:
 extern int yylex();
 extern char *yytext;  // C-style string
+extern int yyleng;    // length of yytext
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_scan_buffer(char *base, size_t size);
+extern YY_BUFFER_STATE yy_create_buffer(FILE *file, int size);
+extern void yy_switch_to_buffer(YY_BUFFER_STATE new_buffer);
+extern void yy_delete_buffer(YY_BUFFER_STATE b);
+static YY_BUFFER_STATE inputBuffer = nullptr;  // the one we made in scanMappedFile or scanStream
 
+#if ! USE_YYLEX
+// Without flex, the flex Lexer reads standard input a line at a time into this,
+//   and scans each line with scanText, like any other Lexer
+//   (no token spans lines, so we never need more than one line at a time)
+static string currentLine = "";
+#endif
+
+
+Lexer::Lexer(string_view source) :
+	usesFlex(false),
+	text(source),
+	textStart(source.data())
+{
+}
+
+Lexer::Lexer() :
+	usesFlex(true)
+{
+}
+
+Lexer &flexLexer()
+{
+	static Lexer theFlexLexer;
+	return theFlexLexer;
+}
 
-string currentToken()
+string Lexer::currentToken() const
 {
 	precondition(calledGetNextTokenAlready);
 	precondition(tokenAvailable());
 	
+	return string(current);
+}
+
+string_view Lexer::currentTokenView() const
+{
+	precondition(calledGetNextTokenAlready);
+	precondition(tokenAvailable());
+
 	return current;
 }
-enum kindOfToken currentTokenKind()
+
+size_t Lexer::currentTokenOffset() const
+{
+	precondition(tokenAvailable());
+	precondition(textStart != nullptr);
+
+	return current.data() - textStart;
+}
+
+const char *Lexer::textBase() const
+{
+	return textStart;
+}
+
+size_t Lexer::currentTokenLength() const
+{
+	precondition(tokenAvailable());
+
+	return current.length();
+}
+
+int Lexer::currentTokenValue() const
+{
+	precondition(calledGetNextTokenAlready);
+	precondition(tokenAvailable());
+
+	return currentValue;
+}
+
+enum kindOfToken Lexer::currentTokenKind() const
 {
 	precondition(calledGetNextTokenAlready);
 	precondition(tokenAvailable());
@@ -34,49 +101,263 @@ enum kindOfToken currentTokenKind()
 	return currentKind;
 }
 
-bool tokenAvailable()
+bool Lexer::tokenAvailable() const
 {
 	precondition(calledGetNextTokenAlready);
 	
 	return !endOfInput;
 }
 
-int  tokenNumber()
+int  Lexer::tokenNumber() const
 {
-	return tokenCount;
+	return count;
 }
 
-void getNextToken()
+void Lexer::getNextToken()
 {
 	if (calledGetNextTokenAlready && endOfInput) return;  // No soup for you!
 	
 	calledGetNextTokenAlready = true;
+	if (!usesFlex) {
+		if (!scanText()) {
+			endOfInput = true;
+			current = "";
+		}
+		return;
+	}
 #if USE_YYLEX
 	/// This interfaces with scanner-regexp.cc
 	/// remember to update it from scanner-regexp.l if that is changed!
 	currentKind = kindOfToken(yylex()); // yylex thinks it could return any int but we know better
+	count = tokenCount;                  // the actions in scanner-regexp.l do the counting
 	if (currentKind == 0) {
 		endOfInput = true;
 		current      = "";
 	} else {
-		current      = yytext;
+		current      = string_view(yytext, yyleng);
+		classify();
 	}
 #else
-	/// HERE IS THE OLD CODE, before I tried lex
-	if (endOfInput || !cin) {
-		endOfInput = true;
-	} else {
-		cin >> current;
-		if (cin && current != "<EOF>") {
-			tokenCount++;
-		} else {
+	/// Without flex, use the hand-written scanner, getting another line whenever we run out
+	while (!scanText()) {
+		if (textStart != nullptr || !getline(cin, currentLine)) {  // out of mapped text, or of input
 			endOfInput = true;
+			current = "";
+			return;
 		}
+		currentLine += '\n';
+		text = currentLine;
+		position = 0;
 	}
 #endif
 }
 
+// The same rules as scanner-regexp.l, written out by hand since flex's scanners can't be used
+//   in more than one thread at a time, and so we can look at many characters at once
+//   where that helps (see scanner-blocks.h).
+// As with flex, we take the longest token we can at each point, e.g. "-5" is one INT_LITERAL,
+//   and "<=" is one OP_COMPARE.
+// Return false (with no token) if we reach the end of the text before finding a token.
+static bool isDigit(char c)      { return c >= '0' && c <= '9'; }
+static bool isLetter(char c)     { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+bool Lexer::scanText()
+{
+	const char *chars = text.data();
+	const size_t end = text.length();
+	while (true) {
+		// skip blank space and comments
+		position = skipBlankSpace(chars, position, end);
+		while (position < end && chars[position] == ';') {
+			position = skipCommentText(chars, position, end);
+			position = skipBlankSpace(chars, position, end);
+		}
+		if (position >= end) {
+			return false;
+		}
+
+		size_t start = position;
+		char c = chars[position++];
+		char next = position < end ? chars[position] : '\0';
+		kindOfToken kind = END_OF_INPUT;
+		bool matched = true;
+		switch (c) {
+			case '(': kind = LPAREN;   break;
+			case ')': kind = RPAREN;   break;
+			case '[': kind = LBRACKET; break;
+			case ']': kind = RBRACKET; break;
+			case '+': kind = PLUS;     break;
+			case '*': kind = TIMES;    break;
+			case '=': kind = OP_COMPARE; break;
+			case '-':
+				if (isDigit(next)) {
+					position = skipDigits(chars, position, end);
+					kind = INT_LITERAL;
+				} else {
+					kind = MINUS;
+				}
+				break;
+			case '<':
+			case '>':
+				if (c == '<' && text.substr(start, 5) == "<EOF>") {
+					position = start + 5;
+					kind = END_OF_INPUT;
+				} else {
+					if (next == '=') position++;
+					kind = OP_COMPARE;
+				}
+				break;
+			case '!':
+				if (next == '=') {
+					position++;
+					kind = OP_COMPARE;
+				} else {
+					matched = false;
+				}
+				break;
+			case '#':
+				if (next == 't' || next == 'f') {
+					position++;
+					kind = BOOL_LITERAL;
+				} else {
+					matched = false;
+				}
+				break;
+			default:
+				if (isDigit(c)) {
+					position = skipDigits(chars, position, end);
+					kind = INT_LITERAL;
+				} else if (isLetter(c)) {
+					position = skipIdentifierRest(chars, position, end);
+					kind = IDENTIFIER;
+				} else {
+					matched = false;
+				}
+		}
+
+		if (!matched) {
+			cerr << "Error: illegal token: '" << c << "'\n";
+			continue;
+		}
+		count++;
+		current = text.substr(start, position - start);
+		currentKind = kind;
+		if (kind == END_OF_INPUT) {
+			endOfInput = true;
+			current = "";
+		} else {
+			classify();
+		}
+		return true;
+	}
+}
+
+// Keywords are recognized here, after the IDENTIFIER has been matched (by flex or by scanText),
+//   rather than by separate rules, so both scanners share this one list;
+//   checking the length first means most identifiers are rejected without comparing any characters.
+static kindOfToken keywordKind(string_view name)
+{
+	switch (name.length()) {
+		case 2: if (name == "if")      return KW_IF;      break;
+		case 4: if (name == "exit")    return KW_EXIT;    break;
+		case 6: if (name == "getint")  return KW_GETINT;  break;
+		case 7: if (name == "letstar") return KW_LETSTAR; break;
+	}
+	return IDENTIFIER;
+}
+
+void Lexer::classify()
+{
+	currentValue = 0;
+	if (currentKind == IDENTIFIER) {
+		currentKind = keywordKind(current);
+		if (currentKind == IDENTIFIER) {
+			currentValue = symbols.intern(current);
+		}
+	} else if (currentKind == INT_LITERAL) {
+		auto [end, problem] = from_chars(current.data(), current.data() + current.length(), currentValue);
+		if (problem == errc::result_out_of_range) {
+			currentKind = INT_OUT_OF_RANGE;
+			currentValue = 0;
+		}
+	} else if (currentKind == BOOL_LITERAL) {
+		currentValue = (current == "#t");
+	}
+}
+
+bool Lexer::startNextProgram()
+{
+	precondition(!usesFlex);
+	precondition(calledGetNextTokenAlready && !tokenAvailable());
+
+	size_t next = skipBlankSpace(text.data(), position, text.length());
+	while (next < text.length() && text[next] == ';') {
+		next = skipCommentText(text.data(), next, text.length());
+		next = skipBlankSpace(text.data(), next, text.length());
+	}
+	if (next >= text.length()) {
+		return false;
+	}
+	position = next;
+	count = 0;
+	endOfInput = false;
+	calledGetNextTokenAlready = false;
+	return true;
+}
+
+void Lexer::restart()
+{
+	count = 0;
+	tokenCount = 0;
+	endOfInput = false;
+	calledGetNextTokenAlready = false;
+	current = "";
+}
+
+void scanMappedFile(MappedFile &source)
+{
+	precondition(source.ok());
+
+	Lexer &lexer = flexLexer();
+	lexer.restart();
+	lexer.textStart = source.data();
+#if USE_YYLEX
+	// flex scans the mapping in place; it needs to see the two NULs after the text, hence "+ 2"
+	if (inputBuffer) yy_delete_buffer(inputBuffer);
+	inputBuffer = yy_scan_buffer(source.data(), source.size() + 2);
+#else
+	lexer.text = source.text();
+	lexer.position = 0;
+#endif
+}
+
+void scanStream(FILE *in)
+{
+	Lexer &lexer = flexLexer();
+	lexer.restart();
+	lexer.textStart = nullptr;
+#if USE_YYLEX
+	if (inputBuffer) yy_delete_buffer(inputBuffer);
+	inputBuffer = yy_create_buffer(in, 16384);  // 16384 is flex's own default buffer size
+	yy_switch_to_buffer(inputBuffer);
+#else
+	precondition(in == stdin);  // without flex, we read standard input through cin
+	lexer.text = "";
+	lexer.position = 0;
+#endif
+}
+
 void scannerError()
 {
 	cerr << "Error: illegal token: '" << yytext << "'\n";
 }
+
+
+string currentToken()              { return flexLexer().currentToken(); }
+enum kindOfToken currentTokenKind() { return flexLexer().currentTokenKind(); }
+string_view currentTokenView()      { return flexLexer().currentTokenView(); }
+size_t currentTokenOffset()         { return flexLexer().currentTokenOffset(); }
+size_t currentTokenLength()         { return flexLexer().currentTokenLength(); }
+bool tokenAvailable()               { return flexLexer().tokenAvailable(); }
+int  tokenNumber()                  { return flexLexer().tokenNumber(); }
+void getNextToken()                 { flexLexer().getNextToken(); }
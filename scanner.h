@@ -1,27 +1,117 @@
 #ifndef _SCANNER_H_
 #define _SCANNER_H_
 
+#include <cstdio>
 #include <string>
+#include <string_view>
 #include "scanner-regexp.h"
+#include "MappedFile.h"
+#include "SymbolTable.h"
 
 // A simple lexical scanner
+//
+// All the scanner's state is kept in a Lexer object, so that several programs can be scanned at once
+//   (e.g. in separate threads), each with its own Lexer.
+// A Lexer built from a string_view scans that text in place, using the same rules as scanner-regexp.l;
+//   there can be any number of those.
+// There is also exactly one Lexer that uses the flex scanner itself, "flexLexer()" below;
+//   flex keeps its state in global variables, so it can't be shared between threads.
+//   (If scanner.cc is compiled with -DUSE_YYLEX=0, the "flex" Lexer uses the hand-written scanner instead,
+//   reading standard input a line at a time.)
+//   The free functions at the end of this file (currentToken() etc.) all use that one.
 
-// return the current token
-//  precondition:     you have called getNextToken at least once
-//                and tokenAvialable did not return false
+class Lexer {
+public:
+	Lexer(std::string_view source);  // scan "source", which must last as long as this Lexer is used
+
+	// return the current token
+	//  precondition:     you have called getNextToken at least once
+	//                and tokenAvialable did not return false
+	std::string currentToken() const;
+	enum kindOfToken currentTokenKind() const;
+
+	// return the value of the current token, already converted from its text:
+	//   for an INT_LITERAL, the integer; for a BOOL_LITERAL, 1 for #t and 0 for #f;
+	//   for an IDENTIFIER, its ID in symbolTable(); for anything else, 0
+	//  precondition: same as currentToken
+	int currentTokenValue() const;
+
+	// the names of all the IDENTIFIERs seen so far
+	const SymbolTable &symbolTable() const { return symbols; }
+
+	// return the current token without copying it
+	//  precondition: same as currentToken
+	//  note: for the flex Lexer reading a stream, the view is only good until the next call to getNextToken;
+	//        otherwise it's good as long as the text being scanned is
+	std::string_view currentTokenView() const;
+
+	// where the current token is within the text (or MappedFile) being scanned
+	//  precondition: same as currentToken, and the text is in memory (i.e., not scanned from a stream)
+	std::size_t currentTokenOffset() const;
+	std::size_t currentTokenLength() const;
+
+	// the start of the text being scanned (what currentTokenOffset counts from),
+	//   or nullptr if the tokens aren't coming from text in memory
+	const char *textBase() const;
+
+	// see if there is a token (return false for end-of-input or the special input <EOF>)
+	//  precondition: you must have called getNextToken at least once
+	bool tokenAvailable() const;
+
+	// return the number of tokens scanned so far
+	// precondition: true
+	int  tokenNumber() const;
+
+	// advance current token to the next input
+	// precondition: true
+	void getNextToken();
+
+	// after the special input <EOF>, get ready to scan the program that follows it, starting with a
+	//   fresh token count; return false (and don't change anything) if there's nothing left to scan
+	//   but blank space and comments
+	// precondition: !tokenAvailable(), and this is not the flex Lexer
+	bool startNextProgram();
+
+private:
+	Lexer();  // the flex Lexer, see flexLexer()
+	friend Lexer &flexLexer();
+	friend void scanMappedFile(MappedFile &source);
+	friend void scanStream(FILE *input);
+
+	void restart();      // start over, e.g. after switching to a new input
+	bool scanText();     // find the next token in "text", starting at "position"
+	void classify();     // work out the keyword kind and value of a newly-scanned token
+
+	bool usesFlex;
+	std::string_view text;        // what we're scanning, if not using flex on a stream
+	std::size_t position = 0;     // how far we've scanned in "text"
+	const char *textStart = nullptr;  // start of the text the tokens are in, if it's in memory
+
+	int count = 0;
+	bool endOfInput = false;
+	bool calledGetNextTokenAlready = false;
+	std::string_view current = "";  // a view of the token, not a copy
+	kindOfToken currentKind = END_OF_INPUT;
+	int currentValue = 0;
+	SymbolTable symbols;
+};
+
+// the one Lexer that uses flex (initially scanning standard input)
+Lexer &flexLexer();
+
+// choose where the flex Lexer's tokens come from, and start over from the first token of that input
+// precondition for scanMappedFile: source.ok(), and source will last as long as we scan it
+void scanMappedFile(MappedFile &source);
+void scanStream(FILE *input);
+
+// shorthand for the same methods of flexLexer(), with the same preconditions
 std::string currentToken();
 enum kindOfToken currentTokenKind();
-
-// see if there is a token (return false for end-of-input or the special input <EOF>)
-//  precondition: you must have called getNextToken at least once
+std::string_view currentTokenView();
+std::size_t currentTokenOffset();
+std::size_t currentTokenLength();
 bool tokenAvailable();
-
-// return the number of tokens scanned so far
-// precondition: true
 int  tokenNumber();
-
-// advance current token to the next input
-// precondition: true
 void getNextToken();
 
 #endif //_SCANNER_H_
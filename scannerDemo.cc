@@ -1,5 +1,9 @@
 #include <iostream>
+#include <chrono>
+#include <cstdio>
 #include "scanner.h"
+#include "scanner-blocks.h"
+#include "TokenBuffer.h"
 #include "scannerDemo.h"
 
 using std::cout;
@@ -14,3 +18,93 @@ void scannerDemo()
 	}
 	cout << "Reached end-of-file, now stopping!" << endl;
 }
+
+
+// scan everything, return the number of tokens; "copyTokens" copies each one into a string,
+//   as getNextToken did before it offered currentTokenView
+static int scanAll(Lexer &lexer, bool copyTokens)
+{
+	std::string copy;
+	std::size_t totalLength = 0;  // use the tokens, so the compiler can't skip anything
+	while (lexer.getNextToken(), lexer.tokenAvailable()) {
+		if (copyTokens) {
+			copy = lexer.currentToken();
+			totalLength += copy.length();
+		} else {
+			totalLength += lexer.currentTokenView().length();
+		}
+	}
+	return totalLength > 0 ? lexer.tokenNumber() : 0;
+}
+
+static void report(const char *how, int tokens, std::size_t bytes, std::chrono::duration<double> time)
+{
+	cout << how << ": " << tokens << " tokens in " << time.count() << " s, "
+	     << tokens / time.count() << " tokens/s, "
+	     << bytes / time.count() / 1e6 << " MB/s" << endl;
+}
+
+// do two lexers produce exactly the same tokens? (if not, say where they differ)
+static bool sameTokens(const TokenBuffer &a, const TokenBuffer &b, const char *bName)
+{
+	for (std::size_t i = 0; i < a.size() && i < b.size(); i++) {
+		if (a.kind(i) != b.kind(i) || a.text(i) != b.text(i) || a.value(i) != b.value(i)) {
+			std::cerr << bName << " differs from flex at token #" << i+1 << ": '" << b.text(i)
+			          << "' instead of '" << a.text(i) << "'" << endl;
+			return false;
+		}
+	}
+	if (a.size() != b.size()) {
+		std::cerr << bName << " found " << b.size() << " tokens, but flex found " << a.size() << endl;
+		return false;
+	}
+	return true;
+}
+
+void scannerBenchmark(const char *path)
+{
+	using clock = std::chrono::steady_clock;
+
+	MappedFile source(path);
+	if (!source.ok()) {
+		std::cerr << "can't read " << path << endl;
+		return;
+	}
+
+	FILE *in = fopen(path, "r");
+	scanStream(in);
+	auto start = clock::now();
+	int tokens = scanAll(flexLexer(), true);
+	report("flex via stdio, copying tokens", tokens, source.size(), clock::now() - start);
+	fclose(in);
+
+	scanMappedFile(source);
+	start = clock::now();
+	tokens = scanAll(flexLexer(), false);
+	report("flex via mmap, string_view tokens", tokens, source.size(), clock::now() - start);
+
+	int widest = blockScanWidth;
+	for (int width = 1; width <= widest; width *= 2) {
+		if (width != 1 && width != 16 && width != 32) continue;
+		blockScanWidth = width;
+		Lexer inPlace(source.text());
+		start = clock::now();
+		tokens = scanAll(inPlace, false);
+		std::string how = "Lexer via mmap, " + (width == 1 ? std::string("scalar") : std::to_string(width) + "-byte blocks");
+		report(how.c_str(), tokens, source.size(), clock::now() - start);
+	}
+
+	// and make sure the hand-written scanner agrees with flex, token for token
+	scanMappedFile(source);
+	TokenBuffer fromFlex(flexLexer());
+	bool allSame = true;
+	for (int width = 1; width <= widest; width *= 2) {
+		if (width != 1 && width != 16 && width != 32) continue;
+		blockScanWidth = width;
+		Lexer inPlace(source.text());
+		TokenBuffer fromLexer(inPlace);
+		allSame = sameTokens(fromFlex, fromLexer, ("Lexer with width " + std::to_string(width)).c_str()) && allSame;
+	}
+	blockScanWidth = widest;
+	cout << (allSame ? "All lexers produced the same " : "Lexers DISAGREE on the ") << fromFlex.size() << " tokens" << endl;
+}
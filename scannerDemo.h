@@ -10,4 +10,10 @@
 
 void scannerDemo();
 
+// time the scanner on the named file, reading it through stdio (the way standard input is read)
+//   and then scanning it in place via a MappedFile, with flex and with the hand-written Lexer
+//   (one character at a time and in SIMD blocks); report tokens and MB per second for each,
+//   and check that they all produce the same tokens
+void scannerBenchmark(const char *path);
+
 #endif /* SCANNER_DEMO_H_ */
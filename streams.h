@@ -1,3 +1,4 @@
-extern std::ostream &trace;
-extern std::ostream &prompt;
+extern thread_local std::ostream &trace;
+extern thread_local std::ostream &prompt;
+extern thread_local std::ostream &alloc_trace;  // for memory allocation; see AST.cc
 // extern std::ostream &debug;  // could separate these if we had a reason to do so...